@@ -5,6 +5,8 @@
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "threads/io.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
@@ -12,6 +14,9 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "filesys/filesys.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 #endif
 
 /* Keyboard control register port. */
@@ -130,6 +135,11 @@ print_stats (void)
 {
   timer_print_stats ();
   thread_print_stats ();
+  if (thread_schedstat)
+    {
+      palloc_print_stats ();
+      malloc_print_stats ();
+    }
 #ifdef FILESYS
   block_print_stats ();
 #endif
@@ -138,4 +148,7 @@ print_stats (void)
 #ifdef USERPROG
   exception_print_stats ();
 #endif
+#ifdef VM
+  vm_print_stats ();
+#endif
 }
@@ -24,7 +24,23 @@ static int64_t ticks;
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* Tickless idle.  While only the idle thread can run, the PIT is
+   slowed down to interrupt when the next sleeping thread is due,
+   and the ticks skipped are made up when it fires or when some
+   other interrupt ends the idle period. */
+bool timer_tickless;
+
+/* PIT cycles per timer tick. */
+#define TICK_COUNT ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Longest period the 16-bit PIT counter can hold, in ticks. */
+#define IDLE_MAX_TICKS (65536 / TICK_COUNT)
+
+static int idle_period;         /* Ticks per PIT period, 1 if not idle. */
+static int64_t interrupt_cnt;   /* # of timer interrupts. */
+
 static intr_handler_func timer_interrupt;
+static void timer_advance (int64_t n);
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
@@ -36,6 +52,7 @@ void
 timer_init (void) 
 {
   pit_configure_channel (0, 2, TIMER_FREQ);
+  idle_period = 1;
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
 
@@ -165,32 +182,96 @@ timer_ndelay (int64_t ns)
 void
 timer_print_stats (void) 
 {
-  printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+  printf ("Timer: %"PRId64" ticks, %"PRId64" interrupts\n",
+          timer_ticks (), interrupt_cnt);
 }
 
+/* Called by the idle thread, with interrupts off, just before it
+   halts.  In tickless mode, stretches the PIT period to cover the
+   ticks until the next sleeping thread wakes up, as far as the
+   16-bit counter allows. */
+void
+timer_idle_enter (void)
+{
+  int64_t n;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!timer_tickless || idle_period != 1)
+    return;
+
+  n = thread_next_wakeup () - ticks;
+  if (n > IDLE_MAX_TICKS)
+    n = IDLE_MAX_TICKS;
+  if (n <= 1)
+    return;
+
+  idle_period = n;
+  pit_configure_count (0, 2, n * TICK_COUNT);
+}
+
+/* Called by the idle thread once it wakes up.  If an interrupt
+   other than the timer's ended the idle period early, makes up
+   the ticks that have passed, to the nearest tick, and returns
+   the PIT to one interrupt per tick. */
+void
+timer_idle_exit (void)
+{
+  enum intr_level old_level = intr_disable ();
+
+  if (idle_period != 1)
+    {
+      unsigned elapsed = idle_period * TICK_COUNT - pit_read_count (0);
+
+      pit_configure_channel (0, 2, TIMER_FREQ);
+      idle_period = 1;
+      timer_advance ((elapsed + TICK_COUNT / 2) / TICK_COUNT);
+    }
+  intr_set_level (old_level);
+}
+
 /* Timer interrupt handler. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED)
 {
-  ticks++;
-  /* RUNNING thread's recent_cpu increase here */
-  thread_tick ();
-  /* Wake up threads time to wake up */
-  thread_wake (ticks);
-
-  #ifndef USERPROG
-  /* Recalculate prioirty
-     For BSD scheduer */
-  if(thread_mlfqs == true) {
-    if(ticks % TIMER_FREQ == 0) {
-      cal_load_avg();
-      cal_recent_cpu_all();
+  int n = idle_period;
+
+  interrupt_cnt++;
+  if (n != 1)
+    {
+      /* End of a tickless idle period. */
+      pit_configure_channel (0, 2, TIMER_FREQ);
+      idle_period = 1;
     }
-    if(ticks % 4 == 0) {
-      cal_priority_all();
+  timer_advance (n);
+}
+
+/* Does the work of N timer ticks. */
+static void
+timer_advance (int64_t n)
+{
+  while (n-- > 0)
+    {
+      ticks++;
+      /* RUNNING thread's recent_cpu increase here */
+      thread_tick ();
+      /* Wake up threads time to wake up */
+      thread_wake (ticks);
+
+      #ifndef USERPROG
+      /* Recalculate prioirty
+         For BSD scheduer */
+      if(thread_mlfqs == true) {
+        if(ticks % TIMER_FREQ == 0) {
+          cal_load_avg();
+          cal_recent_cpu_all();
+        }
+        if(ticks % 4 == 0) {
+          cal_priority_all();
+        }
+      }
+      #endif
     }
-  }
-  #endif
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -0,0 +1,412 @@
+#include "filesys/cache.h"
+#include <debug.h>
+#include <stdint.h>
+#include <string.h>
+#include "filesys/filesys.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Buffer cache of file system sectors.
+
+   Every read and write of fs_device goes through the cache.
+   Writes only mark the cached copy dirty.  The flusher thread
+   writes back sectors that have been dirty for FLUSH_AGE ticks,
+   and a writer that finds too much of the cache dirty writes
+   some back itself, so that only a bounded amount of data is
+   ever at risk.  Otherwise a sector reaches the disk when its
+   entry is evicted or at cache_flush().  Entries are replaced by
+   the clock algorithm.
+
+   Sectors that are likely to be read soon can be queued with
+   cache_read_ahead().  The read-ahead thread brings them in with
+   the cache unlocked, so that other accesses go on meanwhile. */
+
+/* Number of sectors in the cache. */
+#define CACHE_SIZE 64
+
+/* Write-behind. */
+#define FLUSH_INTERVAL TIMER_FREQ       /* Ticks between flusher passes. */
+#define FLUSH_AGE (5 * TIMER_FREQ)      /* Ticks dirty before flushing. */
+#define DIRTY_HIGH (CACHE_SIZE / 2)     /* Dirty entries to throttle at. */
+#define DIRTY_LOW (CACHE_SIZE / 4)      /* ...and to throttle down to. */
+
+/* A cached sector. */
+struct cache_entry 
+  {
+    block_sector_t sector;              /* Sector number, if valid. */
+    bool valid;                         /* Holds a sector? */
+    bool dirty;                         /* Newer than the disk? */
+    bool accessed;                      /* Used since the clock passed? */
+    bool busy;                          /* In use with cache unlocked? */
+    struct thread *pinner;              /* Thread copying, if pinned. */
+    int64_t dirty_since;                /* Tick it became dirty. */
+    uint8_t data[BLOCK_SECTOR_SIZE];    /* Sector contents. */
+  };
+
+static struct cache_entry cache[CACHE_SIZE];
+static size_t clock_hand;               /* Next entry to consider. */
+static size_t dirty_cnt;                /* # of dirty entries. */
+
+/* Sectors queued for read-ahead, in a ring. */
+#define READ_AHEAD_SIZE 32
+static block_sector_t read_ahead_queue[READ_AHEAD_SIZE];
+static size_t read_ahead_head;          /* Oldest queued sector. */
+static size_t read_ahead_cnt;           /* # of sectors queued. */
+
+/* Protects all of the above. */
+static struct lock cache_lock;
+static struct condition read_ahead_wanted;  /* Queue is not empty. */
+static struct condition cache_io_done;      /* Some busy entry is done. */
+
+static thread_func read_ahead_thread NO_RETURN;
+static thread_func flusher_thread NO_RETURN;
+
+/* Initializes the buffer cache and starts the read-ahead and
+   flusher threads. */
+void
+cache_init (void) 
+{
+  lock_init (&cache_lock);
+  cond_init (&read_ahead_wanted);
+  cond_init (&cache_io_done);
+  thread_create ("readahead", PRI_DEFAULT, read_ahead_thread, NULL);
+  thread_create ("flusher", PRI_DEFAULT, flusher_thread, NULL);
+}
+
+/* Writes back E if it is dirty.  The cache lock must be held. */
+static void
+cache_clean (struct cache_entry *e) 
+{
+  if (e->valid && e->dirty)
+    {
+      block_write (fs_device, e->sector, e->data);
+      e->dirty = false;
+      dirty_cnt--;
+    }
+}
+
+/* Marks E dirty.  The cache lock must be held. */
+static void
+cache_dirty (struct cache_entry *e) 
+{
+  if (!e->dirty)
+    {
+      e->dirty = true;
+      e->dirty_since = timer_ticks ();
+      dirty_cnt++;
+    }
+}
+
+/* Writes back dirty entries that became dirty no later than tick
+   DEADLINE, in ascending sector order to keep seeks short, until
+   no more than KEEP entries are dirty.  The cache lock must be
+   held; it is released during each write, with the entry marked
+   busy. */
+static void
+cache_write_behind (int64_t deadline, size_t keep) 
+{
+  /* A candidate, with what it held when chosen. */
+  struct candidate 
+    {
+      struct cache_entry *e;
+      block_sector_t sector;
+      int64_t dirty_since;
+    };
+  struct candidate run[CACHE_SIZE];
+  size_t cnt = 0;
+  size_t i;
+
+  for (i = 0; i < CACHE_SIZE; i++) 
+    {
+      struct cache_entry *e = &cache[i];
+      size_t j;
+
+      if (!e->valid || !e->dirty || e->busy || e->dirty_since > deadline)
+        continue;
+      for (j = cnt++; j > 0 && run[j - 1].sector > e->sector; j--)
+        run[j] = run[j - 1];
+      run[j].e = e;
+      run[j].sector = e->sector;
+      run[j].dirty_since = e->dirty_since;
+    }
+
+  for (i = 0; i < cnt && dirty_cnt > keep; i++) 
+    {
+      struct cache_entry *e = run[i].e;
+
+      /* Things may have changed while we were writing: the entry
+         may even have been reused for another sector, or written
+         and dirtied again. */
+      if (!e->valid || !e->dirty || e->busy || e->sector != run[i].sector
+          || e->dirty_since != run[i].dirty_since)
+        continue;
+
+      e->busy = true;
+      e->dirty = false;
+      dirty_cnt--;
+      lock_release (&cache_lock);
+      block_write (fs_device, e->sector, e->data);
+      lock_acquire (&cache_lock);
+      e->busy = false;
+      cond_broadcast (&cache_io_done, &cache_lock);
+    }
+}
+
+/* Returns the entry caching SECTOR, or a null pointer if there is
+   none.  The cache lock must be held. */
+static struct cache_entry *
+cache_lookup (block_sector_t sector) 
+{
+  size_t i;
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (cache[i].valid && cache[i].sector == sector)
+      return &cache[i];
+  return NULL;
+}
+
+/* Picks an entry to reuse with the clock algorithm, writes it
+   back if dirty, and returns it, invalid.  The cache lock must be
+   held. */
+static struct cache_entry *
+cache_evict (void) 
+{
+  for (;;) 
+    {
+      struct cache_entry *e = &cache[clock_hand];
+
+      clock_hand = (clock_hand + 1) % CACHE_SIZE;
+      if (!e->valid)
+        return e;
+      if (e->busy)
+        continue;
+      if (e->accessed)
+        e->accessed = false;
+      else
+        {
+          cache_clean (e);
+          e->valid = false;
+          return e;
+        }
+    }
+}
+
+/* Returns the entry for SECTOR, bringing it into the cache if
+   necessary.  If LOAD is false, the caller is about to overwrite
+   the whole sector, so a newly cached sector is not read from
+   disk.  The cache lock must be held. */
+static struct cache_entry *
+cache_get (block_sector_t sector, bool load) 
+{
+  struct cache_entry *e;
+
+  /* Wait for read-ahead, write-behind or another thread's copy to
+     finish with SECTOR.  The entry may be reused before we wake
+     up, so look it up again afterward. */
+  while ((e = cache_lookup (sector)) != NULL && e->busy
+         && e->pinner != thread_current ())
+    cond_wait (&cache_io_done, &cache_lock);
+
+  if (e == NULL)
+    {
+      e = cache_evict ();
+      e->sector = sector;
+      e->valid = true;
+      e->dirty = false;
+      if (load)
+        block_read (fs_device, sector, e->data);
+    }
+  e->accessed = true;
+  return e;
+}
+
+/* Marks E busy on behalf of the current thread and releases the
+   cache lock, so that the caller can copy between E and a buffer
+   that may fault.  Meanwhile other threads wait for E and it is
+   neither evicted nor written back. */
+static void
+cache_pin (struct cache_entry *e) 
+{
+  e->busy = true;
+  e->pinner = thread_current ();
+  lock_release (&cache_lock);
+}
+
+/* Undoes cache_pin(), reacquiring the cache lock. */
+static void
+cache_unpin (struct cache_entry *e) 
+{
+  lock_acquire (&cache_lock);
+  e->busy = false;
+  e->pinner = NULL;
+  cond_broadcast (&cache_io_done, &cache_lock);
+}
+
+/* Reads SIZE bytes starting at byte OFS of SECTOR into BUFFER.
+   BUFFER may be in user memory: it is copied with the cache
+   unlocked. */
+void
+cache_read_at (block_sector_t sector, void *buffer, size_t ofs, size_t size) 
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs + size <= BLOCK_SECTOR_SIZE);
+
+  lock_acquire (&cache_lock);
+  e = cache_get (sector, true);
+  if (e->busy)
+    {
+      /* Already pinned by us: a page fault taken while copying
+         needs the same sector, into kernel memory. */
+      memcpy (buffer, e->data + ofs, size);
+    }
+  else 
+    {
+      cache_pin (e);
+      memcpy (buffer, e->data + ofs, size);
+      cache_unpin (e);
+    }
+  lock_release (&cache_lock);
+}
+
+/* Writes SIZE bytes from BUFFER into SECTOR, starting at byte
+   OFS.  BUFFER may be in user memory, as for cache_read_at(). */
+void
+cache_write_at (block_sector_t sector, const void *buffer,
+                size_t ofs, size_t size) 
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs + size <= BLOCK_SECTOR_SIZE);
+
+  lock_acquire (&cache_lock);
+  if (dirty_cnt >= DIRTY_HIGH)
+    cache_write_behind (INT64_MAX, DIRTY_LOW);
+  e = cache_get (sector, size < BLOCK_SECTOR_SIZE);
+  if (e->busy)
+    memcpy (e->data + ofs, buffer, size);
+  else 
+    {
+      cache_pin (e);
+      memcpy (e->data + ofs, buffer, size);
+      cache_unpin (e);
+    }
+  cache_dirty (e);
+  lock_release (&cache_lock);
+}
+
+/* Reads all of SECTOR into BUFFER. */
+void
+cache_read (block_sector_t sector, void *buffer) 
+{
+  cache_read_at (sector, buffer, 0, BLOCK_SECTOR_SIZE);
+}
+
+/* Writes all of SECTOR from BUFFER. */
+void
+cache_write (block_sector_t sector, const void *buffer) 
+{
+  cache_write_at (sector, buffer, 0, BLOCK_SECTOR_SIZE);
+}
+
+/* Queues SECTOR to be read into the cache in the background, if
+   it is not cached already.  Read-ahead is only a hint, so the
+   request is dropped if the queue is full. */
+void
+cache_read_ahead (block_sector_t sector) 
+{
+  size_t i;
+
+  lock_acquire (&cache_lock);
+  for (i = 0; i < read_ahead_cnt; i++)
+    if (read_ahead_queue[(read_ahead_head + i) % READ_AHEAD_SIZE] == sector)
+      break;
+  if (i == read_ahead_cnt && read_ahead_cnt < READ_AHEAD_SIZE
+      && cache_lookup (sector) == NULL)
+    {
+      read_ahead_queue[(read_ahead_head + read_ahead_cnt++)
+                       % READ_AHEAD_SIZE] = sector;
+      cond_signal (&read_ahead_wanted, &cache_lock);
+    }
+  lock_release (&cache_lock);
+}
+
+/* Read-ahead thread: reads queued sectors into the cache, oldest
+   first.  The entry is marked busy while the cache is
+   unlocked, so cache_get() waits for it and cache_evict() leaves
+   it alone. */
+static void
+read_ahead_thread (void *aux UNUSED) 
+{
+  lock_acquire (&cache_lock);
+  for (;;) 
+    {
+      block_sector_t sector;
+      struct cache_entry *e;
+
+      while (read_ahead_cnt == 0)
+        cond_wait (&read_ahead_wanted, &cache_lock);
+      sector = read_ahead_queue[read_ahead_head];
+      read_ahead_head = (read_ahead_head + 1) % READ_AHEAD_SIZE;
+      read_ahead_cnt--;
+
+      /* It may have been read on demand since it was queued. */
+      if (cache_lookup (sector) != NULL)
+        continue;
+
+      /* Not marked accessed: if it is not used before the clock
+         comes around, it is the first to go. */
+      e = cache_evict ();
+      e->sector = sector;
+      e->valid = true;
+      e->dirty = false;
+      e->accessed = false;
+      e->busy = true;
+
+      lock_release (&cache_lock);
+      block_read (fs_device, sector, e->data);
+      lock_acquire (&cache_lock);
+
+      e->busy = false;
+      cond_broadcast (&cache_io_done, &cache_lock);
+    }
+}
+
+/* Flusher thread: every FLUSH_INTERVAL ticks, writes back the
+   sectors that have been dirty for at least FLUSH_AGE ticks. */
+static void
+flusher_thread (void *aux UNUSED) 
+{
+  for (;;) 
+    {
+      timer_sleep (FLUSH_INTERVAL);
+      lock_acquire (&cache_lock);
+      cache_write_behind (timer_ticks () - FLUSH_AGE, 0);
+      lock_release (&cache_lock);
+    }
+}
+
+/* Writes every dirty sector back to disk.  Entries that are busy
+   may be in the middle of a write-behind with their dirty bit
+   already clear, so waits for those to finish first. */
+void
+cache_flush (void) 
+{
+  size_t i;
+
+  lock_acquire (&cache_lock);
+  i = 0;
+  while (i < CACHE_SIZE)
+    if (cache[i].busy)
+      {
+        /* Another write-behind may start while we wait. */
+        cond_wait (&cache_io_done, &cache_lock);
+        i = 0;
+      }
+    else
+      i++;
+  for (i = 0; i < CACHE_SIZE; i++)
+    cache_clean (&cache[i]);
+  lock_release (&cache_lock);
+}
@@ -1,52 +1,423 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdint.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
 
+/* The free sectors are also indexed in memory as extents, runs
+   of free sectors that are as long as possible.  Extents are
+   found by address through two hash tables, one keyed by first
+   sector and one by the sector just past the end, so that a
+   released run can be merged with its neighbors.  They are found
+   by size through size classes: class C holds the extents of
+   2**C to 2**(C+1) - 1 sectors.  An allocation first probes the
+   bitmap at its goal sector and just after it, so that it lands
+   next to related data even if that means splitting an extent.
+
+   The bitmap is what is kept on disk.  The extents are rebuilt
+   from it whenever it is read. */
+struct extent
+  {
+    block_sector_t start;               /* First free sector. */
+    size_t cnt;                         /* Number of free sectors. */
+    struct hash_elem start_elem;        /* Element in extents_by_start. */
+    struct hash_elem end_elem;          /* Element in extents_by_end. */
+    struct list_elem class_elem;        /* Element in size_classes[]. */
+  };
+
+#define CLASS_CNT 32                 /* Number of size classes. */
+#define ALLOC_SCAN 8                 /* Candidates examined per class. */
+#define GOAL_WINDOW 64               /* Sectors probed after a goal. */
+
+static struct hash extents_by_start;
+static struct hash extents_by_end;
+static struct list size_classes[CLASS_CNT];
+
+/* Protects the free map and the extents. */
+static struct lock free_map_lock;
+
+/* Returns the size class for an extent of CNT sectors. */
+static int
+size_class (size_t cnt) 
+{
+  ASSERT (cnt > 0);
+  return 31 - __builtin_clz (cnt);
+}
+
+static unsigned
+extent_start_hash (const struct hash_elem *e, void *aux UNUSED) 
+{
+  return hash_int (hash_entry (e, struct extent, start_elem)->start);
+}
+
+static bool
+extent_start_less (const struct hash_elem *a, const struct hash_elem *b,
+                   void *aux UNUSED) 
+{
+  return (hash_entry (a, struct extent, start_elem)->start
+          < hash_entry (b, struct extent, start_elem)->start);
+}
+
+static unsigned
+extent_end_hash (const struct hash_elem *e, void *aux UNUSED) 
+{
+  const struct extent *x = hash_entry (e, struct extent, end_elem);
+  return hash_int (x->start + x->cnt);
+}
+
+static bool
+extent_end_less (const struct hash_elem *a_, const struct hash_elem *b_,
+                 void *aux UNUSED) 
+{
+  const struct extent *a = hash_entry (a_, struct extent, end_elem);
+  const struct extent *b = hash_entry (b_, struct extent, end_elem);
+  return a->start + a->cnt < b->start + b->cnt;
+}
+
+/* Returns the extent that starts at SECTOR, or a null pointer. */
+static struct extent *
+extent_starting_at (block_sector_t sector) 
+{
+  struct extent key;
+  struct hash_elem *e;
+
+  key.start = sector;
+  e = hash_find (&extents_by_start, &key.start_elem);
+  return e != NULL ? hash_entry (e, struct extent, start_elem) : NULL;
+}
+
+/* Returns the extent that ends just before SECTOR, or a null
+   pointer. */
+static struct extent *
+extent_ending_at (block_sector_t sector) 
+{
+  struct extent key;
+  struct hash_elem *e;
+
+  key.start = sector;
+  key.cnt = 0;
+  e = hash_find (&extents_by_end, &key.end_elem);
+  return e != NULL ? hash_entry (e, struct extent, end_elem) : NULL;
+}
+
+/* Indexes extent X. */
+static void
+extent_link (struct extent *x) 
+{
+  hash_insert (&extents_by_start, &x->start_elem);
+  hash_insert (&extents_by_end, &x->end_elem);
+  list_push_front (&size_classes[size_class (x->cnt)], &x->class_elem);
+}
+
+/* Removes extent X from the index, so that it may be changed. */
+static void
+extent_unlink (struct extent *x) 
+{
+  hash_delete (&extents_by_start, &x->start_elem);
+  hash_delete (&extents_by_end, &x->end_elem);
+  list_remove (&x->class_elem);
+}
+
+/* Adds the CNT free sectors starting at START to the extents,
+   merging them with the extents on either side.  If memory runs
+   out the sectors are not indexed, so they will not be allocated
+   again until the free map is next read. */
+static void
+extent_add (block_sector_t start, size_t cnt) 
+{
+  struct extent *left = extent_ending_at (start);
+  struct extent *right = extent_starting_at (start + cnt);
+
+  if (left != NULL)
+    {
+      extent_unlink (left);
+      left->cnt += cnt;
+      if (right != NULL)
+        {
+          extent_unlink (right);
+          left->cnt += right->cnt;
+          free (right);
+        }
+      extent_link (left);
+    }
+  else if (right != NULL)
+    {
+      extent_unlink (right);
+      right->start = start;
+      right->cnt += cnt;
+      extent_link (right);
+    }
+  else 
+    {
+      struct extent *x = malloc (sizeof *x);
+      if (x == NULL)
+        return;
+      x->start = start;
+      x->cnt = cnt;
+      extent_link (x);
+    }
+}
+
+/* Takes the CNT sectors starting at SECTOR out of extent X,
+   which must hold them, splitting X if they lie in its middle.
+   If memory runs out the sectors after them are not indexed, as
+   in extent_add(). */
+static void
+extent_take (struct extent *x, block_sector_t sector, size_t cnt) 
+{
+  block_sector_t end = x->start + x->cnt;
+
+  ASSERT (sector >= x->start && sector + cnt <= end);
+  extent_unlink (x);
+  if (sector > x->start)
+    {
+      x->cnt = sector - x->start;
+      extent_link (x);
+      if (sector + cnt < end)
+        {
+          struct extent *tail = malloc (sizeof *tail);
+          if (tail == NULL)
+            return;
+          tail->start = sector + cnt;
+          tail->cnt = end - tail->start;
+          extent_link (tail);
+        }
+    }
+  else if (sector + cnt < end)
+    {
+      x->start = sector + cnt;
+      x->cnt = end - x->start;
+      extent_link (x);
+    }
+  else
+    free (x);
+}
+
+/* Returns the extent that holds free sector SECTOR, found by
+   stepping back over free sectors to its start, or a null pointer
+   if its start is more than GOAL_WINDOW sectors away. */
+static struct extent *
+extent_containing (block_sector_t sector) 
+{
+  block_sector_t start = sector;
+
+  for (;;) 
+    {
+      struct extent *x = extent_starting_at (start);
+      if (x != NULL)
+        return x->start + x->cnt > sector ? x : NULL;
+      if (start == 0 || sector - start >= GOAL_WINDOW
+          || bitmap_test (free_map, start - 1))
+        return NULL;
+      start--;
+    }
+}
+
+/* Looks for CNT free sectors starting at GOAL or at most
+   GOAL_WINDOW sectors after it.  If found, stores the first into
+   *SECTORP and returns the extent that holds them; otherwise
+   returns a null pointer. */
+static struct extent *
+extent_find_at (size_t cnt, block_sector_t goal, block_sector_t *sectorp) 
+{
+  size_t limit = bitmap_size (free_map);
+  size_t sector;
+
+  if (goal + GOAL_WINDOW < limit)
+    limit = goal + GOAL_WINDOW;
+  for (sector = goal; sector < limit; sector++) 
+    {
+      struct extent *x;
+
+      if (bitmap_test (free_map, sector))
+        continue;
+
+      /* Past GOAL, the first free sector starts an extent. */
+      x = extent_containing (sector);
+      if (x == NULL)
+        return NULL;
+      if (x->start + x->cnt >= sector + cnt)
+        {
+          *sectorp = sector;
+          return x;
+        }
+      sector = x->start + x->cnt;
+    }
+  return NULL;
+}
+
+/* Returns the distance between sectors A and B. */
+static block_sector_t
+distance (block_sector_t a, block_sector_t b) 
+{
+  return a > b ? a - b : b - a;
+}
+
+/* Returns the extent nearest GOAL with at least CNT sectors
+   among the first SCAN extents of size class C, or a null pointer
+   if none of them fits. */
+static struct extent *
+class_find (int c, size_t cnt, block_sector_t goal, size_t scan) 
+{
+  struct extent *best = NULL;
+  struct list_elem *e;
+  size_t examined = 0;
+
+  for (e = list_begin (&size_classes[c]);
+       e != list_end (&size_classes[c]) && examined < scan;
+       e = list_next (e)) 
+    {
+      struct extent *x = list_entry (e, struct extent, class_elem);
+      examined++;
+      if (x->cnt < cnt)
+        continue;
+      if (best == NULL
+          || distance (x->start, goal) < distance (best->start, goal))
+        best = x;
+    }
+  return best;
+}
+
+/* Finds CNT free sectors, preferring those at or just after
+   GOAL, and otherwise the front of the extent nearest GOAL among
+   those that fit in the first ALLOC_SCAN of the smallest size
+   class that has one.  Only the first class can hold extents that
+   are too small; they count toward ALLOC_SCAN too, and that class
+   is searched in full only if no larger class has any extent.
+   Stores the first sector into *SECTORP and returns the extent
+   that holds them, or returns a null pointer if none is found. */
+static struct extent *
+extent_find (size_t cnt, block_sector_t goal, block_sector_t *sectorp) 
+{
+  struct extent *best = extent_find_at (cnt, goal, sectorp);
+  int c;
+
+  if (best != NULL)
+    return best;
+
+  for (c = size_class (cnt); c < CLASS_CNT && best == NULL; c++) 
+    best = class_find (c, cnt, goal, ALLOC_SCAN);
+  if (best == NULL)
+    best = class_find (size_class (cnt), cnt, goal, SIZE_MAX);
+  if (best != NULL)
+    *sectorp = best->start;
+  return best;
+}
+
+/* Rebuilds the extents from the free map. */
+static void
+extents_build (void) 
+{
+  size_t start = 0;
+  int c;
+
+  for (c = 0; c < CLASS_CNT; c++)
+    while (!list_empty (&size_classes[c]))
+      {
+        struct extent *x = list_entry (list_front (&size_classes[c]),
+                                       struct extent, class_elem);
+        extent_unlink (x);
+        free (x);
+      }
+
+  while (start < bitmap_size (free_map)
+         && (start = bitmap_scan (free_map, start, 1, false)) != BITMAP_ERROR) 
+    {
+      size_t end = bitmap_scan (free_map, start, 1, true);
+      if (end == BITMAP_ERROR)
+        end = bitmap_size (free_map);
+      extent_add (start, end - start);
+      start = end;
+    }
+}
+
 /* Initializes the free map. */
 void
 free_map_init (void) 
 {
+  int c;
+
   free_map = bitmap_create (block_size (fs_device));
   if (free_map == NULL)
     PANIC ("bitmap creation failed--file system device is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+
+  lock_init (&free_map_lock);
+  hash_init (&extents_by_start, extent_start_hash, extent_start_less, NULL);
+  hash_init (&extents_by_end, extent_end_hash, extent_end_less, NULL);
+  for (c = 0; c < CLASS_CNT; c++)
+    list_init (&size_classes[c]);
+  extents_build ();
 }
 
-/* Allocates CNT consecutive sectors from the free map and stores
-   the first into *SECTORP.
+/* Allocates CNT consecutive sectors from the free map, as close
+   to sector GOAL as it can, and stores the first into *SECTORP.
+   Only the part of the free map file that changed is written.
    Returns true if successful, false if not enough consecutive
    sectors were available or if the free_map file could not be
    written. */
 bool
-free_map_allocate (size_t cnt, block_sector_t *sectorp)
+free_map_allocate_near (size_t cnt, block_sector_t goal,
+                        block_sector_t *sectorp)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+  struct extent *x;
+  block_sector_t sector;
+  bool success = false;
+
+  ASSERT (cnt > 0);
+
+  lock_acquire (&free_map_lock);
+  x = extent_find (cnt, goal, &sector);
+  if (x != NULL)
     {
-      bitmap_set_multiple (free_map, sector, cnt, false); 
-      sector = BITMAP_ERROR;
+      extent_take (x, sector, cnt);
+      bitmap_set_multiple (free_map, sector, cnt, true);
+      if (free_map_file == NULL
+          || bitmap_write_range (free_map, free_map_file, sector, cnt))
+        {
+          *sectorp = sector;
+          success = true;
+        }
+      else
+        {
+          bitmap_set_multiple (free_map, sector, cnt, false);
+          extent_add (sector, cnt);
+        }
     }
-  if (sector != BITMAP_ERROR)
-    *sectorp = sector;
-  return sector != BITMAP_ERROR;
+  lock_release (&free_map_lock);
+  return success;
+}
+
+/* Allocates CNT consecutive sectors from the free map, anywhere,
+   and stores the first into *SECTORP.  Returns true if
+   successful, false otherwise. */
+bool
+free_map_allocate (size_t cnt, block_sector_t *sectorp)
+{
+  return free_map_allocate_near (cnt, 0, sectorp);
 }
 
 /* Makes CNT sectors starting at SECTOR available for use. */
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
+  lock_acquire (&free_map_lock);
   ASSERT (bitmap_all (free_map, sector, cnt));
   bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  extent_add (sector, cnt);
+  if (free_map_file != NULL)
+    bitmap_write_range (free_map, free_map_file, sector, cnt);
+  lock_release (&free_map_lock);
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -58,6 +429,7 @@ free_map_open (void)
     PANIC ("can't open free map");
   if (!bitmap_read (free_map, free_map_file))
     PANIC ("can't read free map");
+  extents_build ();
 }
 
 /* Writes the free map to disk and closes the free map file. */
@@ -3,21 +3,41 @@
 #include <debug.h>
 #include <round.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Read-ahead window, in sectors.  Each sequential read doubles
+   it, up to the maximum; any other read turns read-ahead off. */
+#define READ_AHEAD_MIN 2
+#define READ_AHEAD_MAX 16
+
+/* Sectors indexed directly by an inode, and by an indirect
+   block. */
+#define DIRECT_CNT 124
+#define INDIRECT_CNT (BLOCK_SECTOR_SIZE / sizeof (block_sector_t))
+
 /* On-disk inode.
-   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+   Must be exactly BLOCK_SECTOR_SIZE bytes long.
+
+   Data sectors are found through a multi-level index: the first
+   DIRECT_CNT directly, the next INDIRECT_CNT through an indirect
+   block, and the rest through a doubly indirect block whose
+   entries are indirect blocks.  A zero entry is a hole that
+   reads as zeros and is allocated when first written.  (Sector 0
+   always holds the free map's inode, so it is never data.) */
 struct inode_disk
   {
-    block_sector_t start;               /* First data sector. */
+    block_sector_t direct[DIRECT_CNT];  /* Direct data sectors. */
+    block_sector_t indirect;            /* Indirect block. */
+    block_sector_t double_indirect;     /* Doubly indirect block. */
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[125];               /* Not used. */
   };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -36,21 +56,147 @@ struct inode
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    off_t read_next;                    /* End of the last read. */
+    off_t read_ahead_end;               /* End of read-ahead so far. */
+    size_t read_ahead;                  /* Read-ahead window in sectors. */
+    struct lock lock;                   /* Protects growth of DATA. */
     struct inode_disk data;             /* Inode content. */
   };
 
+/* Allocates a sector, as close to GOAL as possible, fills it with
+   zeros and stores its number in *SECTORP.  Returns true if
+   successful, false if the disk is full. */
+static bool
+sector_alloc (block_sector_t goal, block_sector_t *sectorp) 
+{
+  static char zeros[BLOCK_SECTOR_SIZE];
+
+  if (!free_map_allocate_near (1, goal, sectorp))
+    return false;
+  cache_write (*sectorp, zeros);
+  return true;
+}
+
+/* Returns the sector in in-inode index entry *SLOT.  If it is a
+   hole and CREATE is true, allocates a sector for it first, near
+   GOAL, and sets *CHANGED.  Returns 0 for a hole, or if
+   allocation fails. */
+static block_sector_t
+slot_get (block_sector_t *slot, bool create, block_sector_t goal,
+          bool *changed) 
+{
+  if (*slot == 0 && create && sector_alloc (goal, slot))
+    *changed = true;
+  return *slot;
+}
+
+/* Same as slot_get(), for entry IDX of index block BLOCK. */
+static block_sector_t
+index_get (block_sector_t block, size_t idx, bool create,
+           block_sector_t goal) 
+{
+  block_sector_t sector;
+
+  cache_read_at (block, &sector, idx * sizeof sector, sizeof sector);
+  if (sector == 0 && create && sector_alloc (goal, &sector))
+    cache_write_at (block, &sector, idx * sizeof sector, sizeof sector);
+  return sector;
+}
+
+/* Returns the sector that holds data sector IDX of the file
+   indexed by DISK_INODE, or 0 if it is a hole.  If CREATE is
+   true, allocates it and any index blocks it needs near GOAL,
+   and sets *CHANGED if DISK_INODE itself was modified.  Returns 0
+   if allocation fails or IDX is beyond the largest file size. */
+static block_sector_t
+index_lookup (struct inode_disk *disk_inode, size_t idx, bool create,
+              block_sector_t goal, bool *changed) 
+{
+  block_sector_t block;
+
+  if (idx < DIRECT_CNT)
+    return slot_get (&disk_inode->direct[idx], create, goal, changed);
+  idx -= DIRECT_CNT;
+
+  if (idx < INDIRECT_CNT)
+    {
+      block = slot_get (&disk_inode->indirect, create, goal, changed);
+      return block != 0 ? index_get (block, idx, create, goal) : 0;
+    }
+  idx -= INDIRECT_CNT;
+
+  if (idx < INDIRECT_CNT * INDIRECT_CNT)
+    {
+      block = slot_get (&disk_inode->double_indirect, create, goal, changed);
+      if (block != 0)
+        block = index_get (block, idx / INDIRECT_CNT, create, goal);
+      return (block != 0
+              ? index_get (block, idx % INDIRECT_CNT, create, goal) : 0);
+    }
+  return 0;
+}
+
+/* Frees index block BLOCK, which is LEVEL levels above the data,
+   and everything it indexes. */
+static void
+index_release_block (block_sector_t block, int level) 
+{
+  size_t i;
+
+  if (level > 0)
+    for (i = 0; i < INDIRECT_CNT; i++) 
+      {
+        block_sector_t sector;
+
+        cache_read_at (block, &sector, i * sizeof sector, sizeof sector);
+        if (sector != 0)
+          index_release_block (sector, level - 1);
+      }
+  free_map_release (block, 1);
+}
+
+/* Frees all the sectors indexed by DISK_INODE. */
+static void
+index_release (struct inode_disk *disk_inode) 
+{
+  size_t i;
+
+  for (i = 0; i < DIRECT_CNT; i++)
+    if (disk_inode->direct[i] != 0)
+      free_map_release (disk_inode->direct[i], 1);
+  if (disk_inode->indirect != 0)
+    index_release_block (disk_inode->indirect, 1);
+  if (disk_inode->double_indirect != 0)
+    index_release_block (disk_inode->double_indirect, 2);
+}
+
 /* Returns the block device sector that contains byte offset POS
-   within INODE.
-   Returns -1 if INODE does not contain data for a byte at offset
-   POS. */
+   within INODE, or 0 if that part of INODE is a hole.
+   If CREATE is true, a hole is filled in first, and 0 is only
+   returned if the disk is full.  New sectors go right after the
+   previous sector of the file if possible, so that sequential
+   files stay contiguous. */
 static block_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) 
+byte_to_sector (struct inode *inode, off_t pos, bool create) 
 {
+  size_t idx = pos / BLOCK_SECTOR_SIZE;
+  block_sector_t goal;
+  bool changed = false;
+  block_sector_t sector;
+
   ASSERT (inode != NULL);
-  if (pos < inode->data.length)
-    return inode->data.start + pos / BLOCK_SECTOR_SIZE;
-  else
-    return -1;
+  goal = inode->sector;
+  if (create && idx > 0)
+    {
+      block_sector_t prev = index_lookup (&inode->data, idx - 1, false, 0,
+                                          &changed);
+      if (prev != 0)
+        goal = prev;
+    }
+  sector = index_lookup (&inode->data, idx, create, goal + 1, &changed);
+  if (changed)
+    cache_write (inode->sector, &inode->data);
+  return sector;
 }
 
 /* List of open inodes, so that opening a single inode twice
@@ -85,21 +231,28 @@ inode_create (block_sector_t sector, off_t length)
   if (disk_inode != NULL)
     {
       size_t sectors = bytes_to_sectors (length);
+      block_sector_t goal = sector;
+      bool changed;
+      size_t i;
+
       disk_inode->length = length;
       disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start)) 
+
+      /* Allocate the initial data now, one sector at a time, so
+         that running out of space shows up here. */
+      for (i = 0; i < sectors; i++)
         {
-          block_write (fs_device, sector, disk_inode);
-          if (sectors > 0) 
-            {
-              static char zeros[BLOCK_SECTOR_SIZE];
-              size_t i;
-              
-              for (i = 0; i < sectors; i++) 
-                block_write (fs_device, disk_inode->start + i, zeros);
-            }
+          goal = index_lookup (disk_inode, i, true, goal + 1, &changed);
+          if (goal == 0)
+            break;
+        }
+      if (i == sectors)
+        {
+          cache_write (sector, disk_inode);
           success = true; 
-        } 
+        }
+      else
+        index_release (disk_inode);
       free (disk_inode);
     }
   return success;
@@ -137,7 +290,11 @@ inode_open (block_sector_t sector)
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  block_read (fs_device, inode->sector, &inode->data);
+  inode->read_next = 0;
+  inode->read_ahead_end = 0;
+  inode->read_ahead = 0;
+  lock_init (&inode->lock);
+  cache_read (inode->sector, &inode->data);
   return inode;
 }
 
@@ -177,8 +334,7 @@ inode_close (struct inode *inode)
       if (inode->removed) 
         {
           free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length)); 
+          index_release (&inode->data);
         }
 
       free (inode); 
@@ -194,6 +350,51 @@ inode_remove (struct inode *inode)
   inode->removed = true;
 }
 
+/* Called before reading from INODE at OFFSET.  Sizes the
+   read-ahead window according to whether this read continues
+   the last one. */
+static void
+read_ahead_update (struct inode *inode, off_t offset) 
+{
+  if (offset == inode->read_next)
+    {
+      inode->read_ahead *= 2;
+      if (inode->read_ahead < READ_AHEAD_MIN)
+        inode->read_ahead = READ_AHEAD_MIN;
+      if (inode->read_ahead > READ_AHEAD_MAX)
+        inode->read_ahead = READ_AHEAD_MAX;
+    }
+  else
+    {
+      inode->read_ahead = 0;
+      inode->read_ahead_end = 0;
+    }
+}
+
+/* Called after a read from INODE that ended at OFFSET.  Queues
+   the sectors in the read-ahead window past OFFSET that have not
+   been queued already. */
+static void
+read_ahead_issue (struct inode *inode, off_t offset) 
+{
+  off_t start = ROUND_UP (offset, BLOCK_SECTOR_SIZE);
+  off_t end = start + inode->read_ahead * BLOCK_SECTOR_SIZE;
+  off_t pos;
+
+  inode->read_next = offset;
+  if (end > inode_length (inode))
+    end = inode_length (inode);
+  for (pos = start > inode->read_ahead_end ? start : inode->read_ahead_end;
+       pos < end; pos += BLOCK_SECTOR_SIZE) 
+    {
+      block_sector_t sector = byte_to_sector (inode, pos, false);
+      if (sector != 0)
+        cache_read_ahead (sector);
+    }
+  if (end > inode->read_ahead_end)
+    inode->read_ahead_end = end;
+}
+
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
    Returns the number of bytes actually read, which may be less
    than SIZE if an error occurs or end of file is reached. */
@@ -202,12 +403,12 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
-  uint8_t *bounce = NULL;
 
+  read_ahead_update (inode, offset);
   while (size > 0) 
     {
       /* Disk sector to read, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      block_sector_t sector_idx = byte_to_sector (inode, offset, false);
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
@@ -220,47 +421,33 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Read full sector directly into caller's buffer. */
-          block_read (fs_device, sector_idx, buffer + bytes_read);
-        }
-      else 
-        {
-          /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-          block_read (fs_device, sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-        }
+      if (sector_idx != 0)
+        cache_read_at (sector_idx, buffer + bytes_read, sector_ofs,
+                       chunk_size);
+      else
+        memset (buffer + bytes_read, 0, chunk_size);
       
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_read += chunk_size;
     }
-  free (bounce);
+  read_ahead_issue (inode, offset);
 
   return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   less than SIZE if the disk fills up or an error occurs.
+   A write past end of file extends the inode; any gap between
+   the old end and OFFSET is left as a hole. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
                 off_t offset) 
 {
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
-  uint8_t *bounce = NULL;
 
   if (inode->deny_write_cnt)
     return 0;
@@ -268,51 +455,36 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
   while (size > 0) 
     {
       /* Sector to write, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      block_sector_t sector_idx;
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
-      /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      off_t inode_left = inode_length (inode) - offset;
+      /* Number of bytes to actually write into this sector. */
       int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
-      int min_left = inode_left < sector_left ? inode_left : sector_left;
+      int chunk_size = size < sector_left ? size : sector_left;
 
-      /* Number of bytes to actually write into this sector. */
-      int chunk_size = size < min_left ? size : min_left;
-      if (chunk_size <= 0)
+      lock_acquire (&inode->lock);
+      sector_idx = byte_to_sector (inode, offset, true);
+      lock_release (&inode->lock);
+      if (sector_idx == 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Write full sector directly to disk. */
-          block_write (fs_device, sector_idx, buffer + bytes_written);
-        }
-      else 
-        {
-          /* We need a bounce buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-
-          /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left) 
-            block_read (fs_device, sector_idx, bounce);
-          else
-            memset (bounce, 0, BLOCK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          block_write (fs_device, sector_idx, bounce);
-        }
+      cache_write_at (sector_idx, buffer + bytes_written,
+                      sector_ofs, chunk_size);
 
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_written += chunk_size;
     }
-  free (bounce);
+
+  /* Extend the file if we wrote past its end. */
+  lock_acquire (&inode->lock);
+  if (offset > inode->data.length)
+    {
+      inode->data.length = offset;
+      cache_write (inode->sector, &inode->data);
+    }
+  lock_release (&inode->lock);
 
   return bytes_written;
 }
@@ -0,0 +1,212 @@
+#include "heap.h"
+#include "../debug.h"
+
+/* A pairing heap is a tree in which each element is no less
+   than any of its children.  An element's children form a
+   doubly linked list through NEXT and PREV, except that the
+   first child's PREV points to the parent instead.  The root
+   has no siblings and a null PREV. */
+
+/* Returns true if A must come out of heap H before B: it is
+   greater, or equal but inserted earlier. */
+static bool
+before (const struct heap *h, const struct heap_elem *a,
+        const struct heap_elem *b)
+{
+  if (h->less (b, a, h->aux))
+    return true;
+  if (h->less (a, b, h->aux))
+    return false;
+  return (int) (a->seq - b->seq) < 0;
+}
+
+/* Links trees A and B, both without siblings, and returns the
+   root of the result. */
+static struct heap_elem *
+link (const struct heap *h, struct heap_elem *a, struct heap_elem *b)
+{
+  if (a == NULL)
+    return b;
+  if (b == NULL)
+    return a;
+  if (before (h, b, a))
+    {
+      struct heap_elem *t = a;
+      a = b;
+      b = t;
+    }
+
+  /* Make B the first child of A. */
+  b->prev = a;
+  b->next = a->child;
+  if (a->child != NULL)
+    a->child->prev = b;
+  a->child = b;
+  a->prev = NULL;
+  return a;
+}
+
+/* Unlinks E, along with its children, from its parent and
+   siblings. */
+static void
+cut (struct heap_elem *e) 
+{
+  if (e->prev->child == e)
+    e->prev->child = e->next;
+  else
+    e->prev->next = e->next;
+  if (e->next != NULL)
+    e->next->prev = e->prev;
+  e->next = e->prev = NULL;
+}
+
+/* Links the list of siblings starting at FIRST into a single
+   tree and returns its root, or a null pointer if FIRST is
+   null.  Siblings are first linked in pairs from left to right,
+   then the pairs are linked from right to left. */
+static struct heap_elem *
+merge_pairs (const struct heap *h, struct heap_elem *first) 
+{
+  struct heap_elem *pairs = NULL;
+  struct heap_elem *root = NULL;
+
+  while (first != NULL) 
+    {
+      struct heap_elem *a = first;
+      struct heap_elem *b = a->next;
+
+      first = b != NULL ? b->next : NULL;
+      a->next = a->prev = NULL;
+      if (b != NULL)
+        b->next = b->prev = NULL;
+      a = link (h, a, b);
+
+      /* Stack the pair, reusing its NEXT. */
+      a->next = pairs;
+      pairs = a;
+    }
+
+  while (pairs != NULL) 
+    {
+      struct heap_elem *next = pairs->next;
+
+      pairs->next = NULL;
+      root = link (h, root, pairs);
+      pairs = next;
+    }
+  return root;
+}
+
+/* Initializes H as an empty heap ordered by LESS given auxiliary
+   data AUX. */
+void
+heap_init (struct heap *h, heap_less_func *less, void *aux) 
+{
+  ASSERT (h != NULL);
+  ASSERT (less != NULL);
+
+  h->root = NULL;
+  h->size = 0;
+  h->seq = 0;
+  h->less = less;
+  h->aux = aux;
+}
+
+/* Inserts E into H. */
+void
+heap_insert (struct heap *h, struct heap_elem *e) 
+{
+  ASSERT (h != NULL);
+  ASSERT (e != NULL);
+
+  e->child = e->next = e->prev = NULL;
+  e->seq = h->seq++;
+  h->root = link (h, h->root, e);
+  h->size++;
+}
+
+/* Returns the largest element in H.  Undefined behavior if H is
+   empty. */
+struct heap_elem *
+heap_max (struct heap *h) 
+{
+  ASSERT (!heap_empty (h));
+  return h->root;
+}
+
+/* Removes and returns the largest element in H.  Undefined
+   behavior if H is empty. */
+struct heap_elem *
+heap_pop_max (struct heap *h) 
+{
+  struct heap_elem *max = heap_max (h);
+
+  h->root = merge_pairs (h, max->child);
+  h->size--;
+  max->child = NULL;
+  return max;
+}
+
+/* Removes E, which must be in H. */
+void
+heap_remove (struct heap *h, struct heap_elem *e) 
+{
+  ASSERT (h != NULL);
+  ASSERT (e != NULL);
+
+  if (e == h->root)
+    {
+      heap_pop_max (h);
+      return;
+    }
+
+  cut (e);
+  h->root = link (h, h->root, merge_pairs (h, e->child));
+  h->size--;
+  e->child = NULL;
+}
+
+/* Restores the order of H after the key of E, which must be in
+   H, was increased. */
+void
+heap_increase (struct heap *h, struct heap_elem *e) 
+{
+  ASSERT (h != NULL);
+  ASSERT (e != NULL);
+
+  /* E is still no less than its children, so only the link to
+     its parent may be wrong.  Move E's subtree up to the top. */
+  if (e != h->root)
+    {
+      cut (e);
+      h->root = link (h, h->root, e);
+    }
+}
+
+/* Restores the order of H after the key of E, which must be in
+   H, was changed in either direction.  E keeps its place among
+   elements that compare equal to it. */
+void
+heap_update (struct heap *h, struct heap_elem *e) 
+{
+  heap_remove (h, e);
+  e->next = e->prev = NULL;
+  h->root = link (h, h->root, e);
+  h->size++;
+}
+
+/* Returns the number of elements in H. */
+size_t
+heap_size (struct heap *h) 
+{
+  ASSERT (h != NULL);
+  return h->size;
+}
+
+/* Returns true if H is empty, false otherwise. */
+bool
+heap_empty (struct heap *h) 
+{
+  ASSERT (h != NULL);
+  return h->root == NULL;
+}
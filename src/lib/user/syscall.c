@@ -182,3 +182,9 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+void
+vmstat (struct vmstat *st)
+{
+  syscall1 (SYS_VMSTAT, st);
+}
@@ -0,0 +1,16 @@
+#ifndef __LIB_VMSTAT_H
+#define __LIB_VMSTAT_H
+
+/* Paging statistics for one process, as returned by the vmstat
+   system call. */
+struct vmstat
+  {
+    unsigned faults;            /* Page faults taken. */
+    unsigned file_loads;        /* Pages read from an executable or file. */
+    unsigned zero_fills;        /* Demand-zero pages created. */
+    unsigned swap_ins;          /* Pages read back from swap. */
+    unsigned evictions;         /* Pages evicted from memory. */
+    unsigned write_backs;       /* Dirty pages written to file or swap. */
+  };
+
+#endif /* lib/vmstat.h */
@@ -0,0 +1,60 @@
+/* Checks that threads waiting for a readers-writer lock are
+   woken in priority order: waiting writers, highest priority
+   first, and then the waiting readers, even those of higher
+   priority than the writers. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func reader_thread;
+static thread_func writer_thread;
+static struct rwlock rwlock;
+
+void
+test_rwlock_priority (void) 
+{
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  rwlock_init (&rwlock);
+
+  rwlock_acquire_write (&rwlock);
+  for (i = 0; i < 5; i++) 
+    {
+      int priority = PRI_DEFAULT + (i + 3) % 5 + 1;
+      char name[16];
+      snprintf (name, sizeof name, "writer %d", priority);
+      thread_create (name, priority, writer_thread, NULL);
+    }
+  for (i = 0; i < 3; i++) 
+    {
+      int priority = PRI_DEFAULT + (i + 1) % 3 + 6;
+      char name[16];
+      snprintf (name, sizeof name, "reader %d", priority);
+      thread_create (name, priority, reader_thread, NULL);
+    }
+  msg ("Main thread releasing the lock.");
+  rwlock_release_write (&rwlock);
+  msg ("Main thread done.");
+}
+
+static void
+reader_thread (void *aux UNUSED) 
+{
+  rwlock_acquire_read (&rwlock);
+  msg ("Thread %s holds the lock.", thread_name ());
+  rwlock_release_read (&rwlock);
+}
+
+static void
+writer_thread (void *aux UNUSED) 
+{
+  rwlock_acquire_write (&rwlock);
+  msg ("Thread %s holds the lock.", thread_name ());
+  rwlock_release_write (&rwlock);
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-priority) begin
+(rwlock-priority) Main thread releasing the lock.
+(rwlock-priority) Thread writer 36 holds the lock.
+(rwlock-priority) Thread writer 35 holds the lock.
+(rwlock-priority) Thread writer 34 holds the lock.
+(rwlock-priority) Thread writer 33 holds the lock.
+(rwlock-priority) Thread writer 32 holds the lock.
+(rwlock-priority) Thread reader 39 holds the lock.
+(rwlock-priority) Thread reader 38 holds the lock.
+(rwlock-priority) Thread reader 37 holds the lock.
+(rwlock-priority) Main thread done.
+(rwlock-priority) end
+EOF
+pass;
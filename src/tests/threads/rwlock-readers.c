@@ -0,0 +1,64 @@
+/* Checks that several threads can hold a readers-writer lock
+   for reading at once, and that a writer waits until the last
+   of them lets go. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func reader_thread;
+static thread_func writer_thread;
+static struct rwlock rwlock;
+static struct semaphore go;
+
+void
+test_rwlock_readers (void) 
+{
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  rwlock_init (&rwlock);
+  sema_init (&go, 0);
+
+  rwlock_acquire_read (&rwlock);
+  msg ("Main thread holds the lock for reading.");
+  for (i = 0; i < 3; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "reader %d", i);
+      thread_create (name, PRI_DEFAULT + 1, reader_thread, NULL);
+    }
+  thread_create ("writer", PRI_DEFAULT + 2, writer_thread, NULL);
+
+  for (i = 0; i < 3; i++) 
+    {
+      msg ("Letting a reader go.");
+      sema_up (&go);
+    }
+  msg ("Main thread releasing the lock.");
+  rwlock_release_read (&rwlock);
+  msg ("Main thread done.");
+}
+
+static void
+reader_thread (void *aux UNUSED) 
+{
+  rwlock_acquire_read (&rwlock);
+  msg ("Thread %s holds the lock for reading.", thread_name ());
+  sema_down (&go);
+  msg ("Thread %s releasing the lock.", thread_name ());
+  rwlock_release_read (&rwlock);
+}
+
+static void
+writer_thread (void *aux UNUSED) 
+{
+  msg ("Writer waiting for the lock.");
+  rwlock_acquire_write (&rwlock);
+  msg ("Writer holds the lock.");
+  rwlock_release_write (&rwlock);
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-readers) begin
+(rwlock-readers) Main thread holds the lock for reading.
+(rwlock-readers) Thread reader 0 holds the lock for reading.
+(rwlock-readers) Thread reader 1 holds the lock for reading.
+(rwlock-readers) Thread reader 2 holds the lock for reading.
+(rwlock-readers) Writer waiting for the lock.
+(rwlock-readers) Letting a reader go.
+(rwlock-readers) Thread reader 0 releasing the lock.
+(rwlock-readers) Letting a reader go.
+(rwlock-readers) Thread reader 1 releasing the lock.
+(rwlock-readers) Letting a reader go.
+(rwlock-readers) Thread reader 2 releasing the lock.
+(rwlock-readers) Main thread releasing the lock.
+(rwlock-readers) Writer holds the lock.
+(rwlock-readers) Main thread done.
+(rwlock-readers) end
+EOF
+pass;
@@ -0,0 +1,49 @@
+/* Checks that once a writer is waiting for a readers-writer
+   lock, new readers queue up behind it instead of joining the
+   readers that already hold the lock. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func reader_thread;
+static thread_func writer_thread;
+static struct rwlock rwlock;
+
+void
+test_rwlock_writer_pref (void) 
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  rwlock_init (&rwlock);
+
+  rwlock_acquire_read (&rwlock);
+  msg ("Main thread holds the lock for reading.");
+  thread_create ("writer", PRI_DEFAULT + 1, writer_thread, NULL);
+  thread_create ("reader", PRI_DEFAULT + 2, reader_thread, NULL);
+  msg ("Main thread releasing the lock.");
+  rwlock_release_read (&rwlock);
+  msg ("Main thread done.");
+}
+
+static void
+reader_thread (void *aux UNUSED) 
+{
+  msg ("Reader waiting for the lock.");
+  rwlock_acquire_read (&rwlock);
+  msg ("Reader holds the lock.");
+  rwlock_release_read (&rwlock);
+}
+
+static void
+writer_thread (void *aux UNUSED) 
+{
+  msg ("Writer waiting for the lock.");
+  rwlock_acquire_write (&rwlock);
+  msg ("Writer holds the lock.");
+  rwlock_release_write (&rwlock);
+  msg ("Writer done.");
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-writer-pref) begin
+(rwlock-writer-pref) Main thread holds the lock for reading.
+(rwlock-writer-pref) Writer waiting for the lock.
+(rwlock-writer-pref) Reader waiting for the lock.
+(rwlock-writer-pref) Main thread releasing the lock.
+(rwlock-writer-pref) Writer holds the lock.
+(rwlock-writer-pref) Reader holds the lock.
+(rwlock-writer-pref) Writer done.
+(rwlock-writer-pref) Main thread done.
+(rwlock-writer-pref) end
+EOF
+pass;
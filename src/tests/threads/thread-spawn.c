@@ -0,0 +1,45 @@
+/* Creates many short-lived threads, one after another, and
+   reports how long it took.  Each thread runs and exits before
+   the next one is created, so this measures the cost of thread
+   creation and exit rather than of scheduling. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 2000
+
+static thread_func spawn_thread;
+static int spawn_cnt;
+
+void
+test_thread_spawn (void) 
+{
+  int64_t start_time;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  spawn_cnt = 0;
+  start_time = timer_ticks ();
+  for (i = 0; i < THREAD_CNT; i++) 
+    if (thread_create ("spawn", PRI_DEFAULT + 1, spawn_thread, NULL)
+        == TID_ERROR)
+      fail ("thread_create() failed after %d threads", i);
+
+  if (spawn_cnt != THREAD_CNT)
+    fail ("only %d of %d threads ran", spawn_cnt, THREAD_CNT);
+  msg ("spawned %d threads in %"PRId64" ticks",
+       THREAD_CNT, timer_elapsed (start_time));
+  pass ();
+}
+
+static void
+spawn_thread (void *aux UNUSED) 
+{
+  spawn_cnt++;
+}
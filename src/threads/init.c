@@ -31,6 +31,11 @@
 #else
 #include "tests/threads/tests.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+#endif
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
@@ -98,6 +103,9 @@ main (void)
   palloc_init (user_page_limit);
   malloc_init ();
   paging_init ();
+#ifdef VM
+  frame_init ();
+#endif
 
   /* Segmentation. */
 #ifdef USERPROG
@@ -126,6 +134,10 @@ main (void)
   locate_block_devices ();
   filesys_init (format_filesys);
 #endif
+#ifdef VM
+  swap_init ();
+  frame_cleaner_start ();
+#endif
 
   printf ("Boot complete.\n");
   
@@ -256,6 +268,10 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-tickless"))
+        timer_tickless = true;
+      else if (!strcmp (name, "-schedstat"))
+        thread_schedstat = true;
 #ifndef USERPROG
       /* Project 3 */
       else if(!strcmp(name, "-aging"))
@@ -264,6 +280,26 @@ parse_options (char **argv)
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-sl"))
+        stack_page_limit = atoi (value);
+      else if (!strcmp (name, "-prefault"))
+        {
+          if (value == NULL || !strcmp (value, "eager"))
+            load_policy = LOAD_EAGER;
+          else if (!strcmp (value, "lazy"))
+            load_policy = LOAD_LAZY;
+          else
+            PANIC ("unknown prefault policy `%s' (use -h for help)", value);
+          load_report_faults = true;
+        }
+      else if (!strcmp (name, "-vmstat"))
+        print_vmstat = true;
+      else if (!strcmp (name, "-clean-interval"))
+        clean_interval = atoi (value);
+      else if (!strcmp (name, "-clean-batch"))
+        clean_batch = atoi (value);
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -384,8 +420,19 @@ usage (void)
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -tickless          Stop the periodic timer tick while idle.\n"
+          "  -schedstat         Print scheduler and lock statistics.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+          "  -sl=COUNT          Limit user stack growth to COUNT pages.\n"
+          "  -prefault[=POLICY] Load executables eagerly, or lazily if POLICY\n"
+          "                     is `lazy', and report page faults at exit.\n"
+          "  -vmstat            Print each process's paging statistics at exit.\n"
+          "  -clean-interval=TICKS\n"
+          "                     Run the page cleaner every TICKS ticks (0 = off).\n"
+          "  -clean-batch=COUNT Write back at most COUNT pages per cleaner pass.\n"
 #endif
           );
   shutdown_power_off ();
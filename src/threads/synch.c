@@ -32,6 +32,55 @@
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 
+/* Returns true if waiter A has lower priority than waiter B. */
+static bool
+waiter_less (const struct heap_elem *a_, const struct heap_elem *b_,
+             void *aux UNUSED)
+{
+  const struct thread *a = heap_entry (a_, struct thread, wait_elem);
+  const struct thread *b = heap_entry (b_, struct thread, wait_elem);
+
+  return a->priority < b->priority;
+}
+
+/* Puts the current thread on waiters heap H.  It stays there,
+   and is re-keyed by priority donation, until wake_max() takes
+   it off.  Must be called with interrupts off. */
+static void
+wait_enqueue (struct heap *h)
+{
+  struct thread *cur = thread_current ();
+
+  heap_insert (h, &cur->wait_elem);
+  cur->wait_heap = h;
+}
+
+/* Blocks until wake_max() has taken the current thread off the
+   heap it was put on by wait_enqueue().  Must be called with
+   interrupts off. */
+static void
+wait_block (void)
+{
+  struct thread *cur = thread_current ();
+
+  while (cur->wait_heap != NULL)
+    thread_block ();
+}
+
+/* Takes the highest priority thread off waiters heap H, which
+   must not be empty, wakes it up if it has blocked already, and
+   returns it.  Must be called with interrupts off. */
+static struct thread *
+wake_max (struct heap *h)
+{
+  struct thread *t = heap_entry (heap_pop_max (h), struct thread, wait_elem);
+
+  t->wait_heap = NULL;
+  if (t->status == THREAD_BLOCKED)
+    thread_unblock (t);
+  return t;
+}
+
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
    manipulating it:
@@ -47,7 +96,7 @@ sema_init (struct semaphore *sema, unsigned value)
   ASSERT (sema != NULL);
 
   sema->value = value;
-  list_init (&sema->waiters);
+  heap_init (&sema->waiters, waiter_less, NULL);
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -68,10 +117,8 @@ sema_down (struct semaphore *sema)
   old_level = intr_disable ();
   while (sema->value == 0) 
     {
-      // list_push_back (&sema->waiters, &thread_current ()->elem);
-      /* Waiters list sorted by priroity */
-      list_insert_ordered(&sema->waiters, &thread_current ()->elem, priority_ordered, NULL);
-      thread_block ();
+      wait_enqueue (&sema->waiters);
+      wait_block ();
     }
   sema->value--;
   intr_set_level (old_level);
@@ -115,9 +162,8 @@ sema_up (struct semaphore *sema)
   ASSERT (sema != NULL);
 
   old_level = intr_disable ();
-  if (!list_empty (&sema->waiters)) 
-    thread_unblock (list_entry (list_pop_front (&sema->waiters),
-                                struct thread, elem));
+  if (!heap_empty (&sema->waiters)) 
+    wake_max (&sema->waiters);
   sema->value++;
   intr_set_level (old_level);
   try_thread_yield();
@@ -182,6 +228,48 @@ lock_init (struct lock *lock)
 
   lock->holder = NULL;
   sema_init (&lock->semaphore, 1);
+  lock->max_priority = PRI_MIN;
+}
+
+/* Donates the current thread's priority along the chain of lock
+   holders it is waiting behind, at most DONATION_DEPTH deep.
+   Must be called with interrupts off. */
+static void
+donate_priority (void)
+{
+  struct thread *t = thread_current ();
+  int depth;
+
+  for (depth = 0; depth < DONATION_DEPTH && t->wait_on_lock != NULL; depth++)
+    {
+      struct lock *lock = t->wait_on_lock;
+      struct thread *holder = lock->holder;
+
+      if (holder == NULL)
+        break;
+      if (lock->max_priority < t->priority)
+        lock->max_priority = t->priority;
+      if (holder->priority >= t->priority)
+        break;
+      thread_donate_priority (holder, t->priority);
+      t = holder;
+    }
+}
+
+/* Makes the current thread the holder of LOCK, which it has just
+   acquired.  Must be called with interrupts off. */
+static void
+lock_take (struct lock *lock)
+{
+  struct thread *cur = thread_current ();
+  struct heap *waiters = &lock->semaphore.waiters;
+
+  lock->holder = cur;
+  lock->max_priority = PRI_MIN;
+  if (!heap_empty (waiters))
+    lock->max_priority = heap_entry (heap_max (waiters),
+                                     struct thread, wait_elem)->priority;
+  list_push_back (&cur->held_locks, &lock->elem);
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -195,12 +283,23 @@ lock_init (struct lock *lock)
 void
 lock_acquire (struct lock *lock)
 {
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
+  if (lock->holder != NULL && !thread_mlfqs)
+    {
+      cur->wait_on_lock = lock;
+      donate_priority ();
+    }
   sema_down (&lock->semaphore);
-  lock->holder = thread_current ();
+  cur->wait_on_lock = NULL;
+  lock_take (lock);
+  intr_set_level (old_level);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -212,14 +311,17 @@ lock_acquire (struct lock *lock)
 bool
 lock_try_acquire (struct lock *lock)
 {
+  enum intr_level old_level;
   bool success;
 
   ASSERT (lock != NULL);
   ASSERT (!lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
   success = sema_try_down (&lock->semaphore);
   if (success)
-    lock->holder = thread_current ();
+    lock_take (lock);
+  intr_set_level (old_level);
   return success;
 }
 
@@ -231,10 +333,20 @@ lock_try_acquire (struct lock *lock)
 void
 lock_release (struct lock *lock) 
 {
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
+  /* Give back what was donated through LOCK.  sema_up() then
+     yields if a waiter now outranks us. */
+  old_level = intr_disable ();
+  list_remove (&lock->elem);
   lock->holder = NULL;
+  if (!thread_mlfqs)
+    thread_refresh_priority ();
+  intr_set_level (old_level);
+
   sema_up (&lock->semaphore);
 }
 
@@ -249,12 +361,199 @@ lock_held_by_current_thread (const struct lock *lock)
   return lock->holder == thread_current ();
 }
 
-/* One semaphore in a list. */
-struct semaphore_elem 
-  {
-    struct list_elem elem;              /* List element. */
-    struct semaphore semaphore;         /* This semaphore. */
-  };
+/* Initializes adaptive lock LOCK. */
+void
+adaptive_lock_init (struct adaptive_lock *lock)
+{
+  ASSERT (lock != NULL);
+
+  lock_init (&lock->lock);
+  lock->contended = 0;
+}
+
+/* Returns true if it is worth yielding to LOCK's holder: it is
+   waiting to run and will be scheduled ahead of us. */
+static bool
+adaptive_lock_should_yield (struct adaptive_lock *lock)
+{
+  enum intr_level old_level = intr_disable ();
+  struct thread *holder = lock->lock.holder;
+  bool yield = (holder != NULL && holder->status == THREAD_READY
+                && holder->priority >= thread_current ()->priority);
+
+  intr_set_level (old_level);
+  return yield;
+}
+
+/* Acquires LOCK.  If it is held by a thread that was preempted
+   inside its critical section, yields to that thread up to
+   ADAPTIVE_YIELDS times before blocking.  A holder that is itself
+   blocked, or that would not be scheduled ahead of us, will not
+   release the lock any sooner, so then we block right away.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+adaptive_lock_acquire (struct adaptive_lock *lock)
+{
+  int i;
+
+  ASSERT (lock != NULL);
+  ASSERT (!intr_context ());
+
+  if (lock_try_acquire (&lock->lock))
+    return;
+
+  lock->contended++;
+  for (i = 0; i < ADAPTIVE_YIELDS && adaptive_lock_should_yield (lock); i++)
+    {
+      thread_yield ();
+      if (lock_try_acquire (&lock->lock))
+        return;
+    }
+  lock_acquire (&lock->lock);
+}
+
+/* Releases LOCK, which must be owned by the current thread. */
+void
+adaptive_lock_release (struct adaptive_lock *lock)
+{
+  ASSERT (lock != NULL);
+
+  lock_release (&lock->lock);
+}
+
+/* Initializes readers-writer lock RW.
+
+   Unlike a lock, a readers-writer lock has no single holder, so
+   no priority is donated through it.  Waiters are instead woken
+   in priority order, and on release the lock is handed straight
+   to the threads it wakes so that nobody can barge in between. */
+void
+rwlock_init (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  rw->writer = NULL;
+  rw->readers = 0;
+  heap_init (&rw->read_waiters, waiter_less, NULL);
+  heap_init (&rw->write_waiters, waiter_less, NULL);
+}
+
+/* Acquires RW for reading, sleeping while a writer holds it or
+   is waiting for it.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!rwlock_held_by_current_thread (rw));
+
+  old_level = intr_disable ();
+  if (rw->writer == NULL && heap_empty (&rw->write_waiters))
+    rw->readers++;
+  else
+    {
+      /* The releasing writer counts us in before waking us. */
+      wait_enqueue (&rw->read_waiters);
+      wait_block ();
+    }
+  intr_set_level (old_level);
+}
+
+/* Acquires RW for writing, sleeping until there are no readers
+   and no other writer.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!rwlock_held_by_current_thread (rw));
+
+  old_level = intr_disable ();
+  if (rw->writer == NULL && rw->readers == 0)
+    rw->writer = thread_current ();
+  else
+    {
+      /* The releasing thread makes us the writer before waking
+         us. */
+      wait_enqueue (&rw->write_waiters);
+      wait_block ();
+    }
+  ASSERT (rw->writer == thread_current ());
+  intr_set_level (old_level);
+}
+
+/* Hands RW, which nobody holds, to the highest priority waiting
+   writer, or else to all the waiting readers, highest priority
+   first.  Must be called with interrupts off. */
+static void
+rwlock_handoff (struct rwlock *rw)
+{
+  ASSERT (rw->writer == NULL && rw->readers == 0);
+
+  if (!heap_empty (&rw->write_waiters))
+    rw->writer = wake_max (&rw->write_waiters);
+  else
+    while (!heap_empty (&rw->read_waiters))
+      {
+        rw->readers++;
+        wake_max (&rw->read_waiters);
+      }
+}
+
+/* Releases RW, which the current thread must hold for reading.
+   The last reader out hands the lock to a waiting writer. */
+void
+rwlock_release_read (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (rw->readers > 0);
+
+  old_level = intr_disable ();
+  if (--rw->readers == 0)
+    rwlock_handoff (rw);
+  intr_set_level (old_level);
+  try_thread_yield ();
+}
+
+/* Releases RW, which the current thread must hold for writing. */
+void
+rwlock_release_write (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (rwlock_held_by_current_thread (rw));
+
+  old_level = intr_disable ();
+  rw->writer = NULL;
+  rwlock_handoff (rw);
+  intr_set_level (old_level);
+  try_thread_yield ();
+}
+
+/* Returns true if the current thread holds RW for writing.
+   Readers are not tracked individually. */
+bool
+rwlock_held_by_current_thread (const struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  return rw->writer == thread_current ();
+}
 
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
@@ -264,7 +563,7 @@ cond_init (struct condition *cond)
 {
   ASSERT (cond != NULL);
 
-  list_init (&cond->waiters);
+  heap_init (&cond->waiters, waiter_less, NULL);
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -290,17 +589,20 @@ cond_init (struct condition *cond)
 void
 cond_wait (struct condition *cond, struct lock *lock) 
 {
-  struct semaphore_elem waiter;
+  enum intr_level old_level;
 
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (lock_held_by_current_thread (lock));
   
-  sema_init (&waiter.semaphore, 0);
-  list_push_back (&cond->waiters, &waiter.elem);
+  /* Releasing LOCK may yield to a waiter for it, which may then
+     signal us before we get to block.  wait_block() copes. */
+  old_level = intr_disable ();
+  wait_enqueue (&cond->waiters);
   lock_release (lock);
-  sema_down (&waiter.semaphore);
+  wait_block ();
+  intr_set_level (old_level);
   lock_acquire (lock);
 }
 
@@ -314,14 +616,18 @@ cond_wait (struct condition *cond, struct lock *lock)
 void
 cond_signal (struct condition *cond, struct lock *lock UNUSED) 
 {
+  enum intr_level old_level;
+
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (lock_held_by_current_thread (lock));
 
-  if (!list_empty (&cond->waiters)) 
-    sema_up (&list_entry (list_pop_front (&cond->waiters),
-                          struct semaphore_elem, elem)->semaphore);
+  old_level = intr_disable ();
+  if (!heap_empty (&cond->waiters)) 
+    wake_max (&cond->waiters);
+  intr_set_level (old_level);
+  try_thread_yield ();
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -336,6 +642,6 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
 
-  while (!list_empty (&cond->waiters))
+  while (!heap_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
@@ -1,6 +1,7 @@
 #ifndef THREADS_SYNCH_H
 #define THREADS_SYNCH_H
 
+#include <heap.h>
 #include <list.h>
 #include <stdbool.h>
 
@@ -8,7 +9,7 @@
 struct semaphore 
   {
     unsigned value;             /* Current value. */
-    struct list waiters;        /* List of waiting threads. */
+    struct heap waiters;        /* Waiting threads, by priority. */
   };
 
 void sema_init (struct semaphore *, unsigned value);
@@ -22,18 +23,58 @@ struct lock
   {
     struct thread *holder;      /* Thread holding lock (for debugging). */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
+    int max_priority;           /* Highest priority donated via lock. */
+    struct list_elem elem;      /* Element in holder's held_locks. */
   };
 
+/* Longest chain of locks that priority is donated through. */
+#define DONATION_DEPTH 8
+
 void lock_init (struct lock *);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
 
+/* Adaptive lock, for short critical sections.  If the holder is
+   ready to run, yields to it a few times in the hope that it
+   releases the lock, before blocking as a plain lock would. */
+struct adaptive_lock
+  {
+    struct lock lock;           /* Underlying lock. */
+    unsigned contended;         /* # of acquires that found it held,
+                                   printed at shutdown by -schedstat. */
+  };
+
+/* Most yields to the holder before blocking. */
+#define ADAPTIVE_YIELDS 4
+
+void adaptive_lock_init (struct adaptive_lock *);
+void adaptive_lock_acquire (struct adaptive_lock *);
+void adaptive_lock_release (struct adaptive_lock *);
+
+/* Readers-writer lock.  Any number of readers, or a single
+   writer, may hold it at once.  Writers are preferred: once a
+   writer is waiting, new readers wait behind it. */
+struct rwlock
+  {
+    struct thread *writer;      /* Writer holding lock, if any. */
+    unsigned readers;           /* # of readers holding lock. */
+    struct heap read_waiters;   /* Threads waiting to read. */
+    struct heap write_waiters;  /* Threads waiting to write. */
+  };
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_held_by_current_thread (const struct rwlock *);
+
 /* Condition variable. */
 struct condition 
   {
-    struct list waiters;        /* List of waiting threads. */
+    struct heap waiters;        /* Waiting threads, by priority. */
   };
 
 void cond_init (struct condition *);
@@ -1,5 +1,6 @@
 #include "threads/thread.h"
 #include <debug.h>
+#include <inttypes.h>
 #include <stddef.h>
 #include <random.h>
 #include <stdio.h>
@@ -11,6 +12,7 @@
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
@@ -23,9 +25,14 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Processes in THREAD_READY state, that is, processes that are
+   ready to run but not actually running.  There is one FIFO
+   queue per priority; bit P of ready_mask is set if and only if
+   ready_queues[P] is nonempty, so the highest priority ready
+   thread is found with a single bit scan. */
+static struct list ready_queues[PRI_MAX + 1];
+static uint32_t ready_mask[(PRI_MAX + 32) / 32];
+static size_t ready_cnt;        /* # of threads in ready_queues. */
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
@@ -37,6 +44,13 @@ static struct thread *idle_thread;
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
 
+/* Pages of exited threads, kept for thread_create() to reuse so
+   that short-lived threads skip the page allocator.  Each page is
+   linked through its dead thread's `elem'. */
+#define THREAD_CACHE_MAX 16     /* Most pages kept. */
+static struct list thread_cache;
+static size_t thread_cache_cnt; /* # of pages in thread_cache. */
+
 /* Lock used by allocate_tid(). */
 static struct lock tid_lock;
 
@@ -57,6 +71,16 @@ static long long user_ticks;    /* # of timer ticks in user programs. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
 static unsigned thread_ticks;   /* # of timer ticks since last yield. */
 
+/* Scheduling latency, the time from being put on a ready queue
+   to running, as a histogram.  Bucket 0 counts waits of 0 ticks,
+   bucket B of 2**(B-1) to 2**B - 1 ticks, and the last bucket
+   everything longer. */
+#define LATENCY_BUCKETS 12
+static unsigned latency_hist[LATENCY_BUCKETS];
+
+/* Print scheduler statistics? */
+bool thread_schedstat;
+
 #ifndef USERPROG
 /* Project 3 */
 bool thread_prior_aging;
@@ -78,6 +102,15 @@ static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static struct thread *thread_page_get (void);
+static void thread_page_put (struct thread *);
+
+static void sched_account (struct thread *cur, struct thread *next);
+static void thread_print_sched (struct thread *);
+static void ready_push (struct thread *);
+static struct thread *ready_pop (void);
+static void ready_move (struct thread *, int old_priority);
+static int ready_max_priority (void);
 
 /* Project 1 */
 struct thread *searchChild(tid_t child_tid);
@@ -86,10 +119,26 @@ struct thread *searchChild(tid_t child_tid);
 #ifndef USERPROG
 void thread_aging();
 #endif
-static struct list sleep_list;
+
+/* Sleeping threads, in a hashed timing wheel.  A thread that
+   wakes at tick T is in slot T % SLEEP_WHEEL_SIZE, and each slot
+   is sorted by wakeup tick, so a timer tick only has to look at
+   the front of its own slot. */
+#define SLEEP_WHEEL_SIZE 64     /* Power of 2. */
+static struct list sleep_wheel[SLEEP_WHEEL_SIZE];
+static int64_t sleep_wheel_now; /* Last tick passed to thread_wake(). */
+
 // static FIXED load_avg;
 static FIXED load_avg;
 
+#ifndef USERPROG
+/* recent_cpu decay coefficient of each of the last DECAY_RING
+   seconds, indexed by second modulo DECAY_RING */
+#define DECAY_RING 64
+static FIXED decay_coef[DECAY_RING];
+static int decay_epoch;         /* Seconds of decay so far */
+#endif
+
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -107,11 +156,15 @@ static FIXED load_avg;
 void
 thread_init (void) 
 {
+  int i;
+
   ASSERT (intr_get_level () == INTR_OFF);
 
   lock_init (&tid_lock);
-  list_init (&ready_list);
+  for (i = PRI_MIN; i <= PRI_MAX; i++)
+    list_init (&ready_queues[i]);
   list_init (&all_list);
+  list_init (&thread_cache);
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
@@ -121,7 +174,8 @@ thread_init (void)
 
   /* Project 3 */
   /* Init load_avg */
-  list_init(&sleep_list);
+  for (i = 0; i < SLEEP_WHEEL_SIZE; i++)
+    list_init(&sleep_wheel[i]);
   load_avg = F_INIT(0);
   initial_thread->recent_cpu = F_INIT(0);
   initial_thread->nice = 0;
@@ -161,9 +215,12 @@ thread_tick (void)
 #endif
   else 
     kernel_ticks++;
+  t->run_ticks++;
 
-  /* Enforce preemption. */
-  if (++thread_ticks >= TIME_SLICE)
+  /* Enforce preemption.  Ticks made up after a tickless idle
+     period are counted outside interrupt context, in the idle
+     thread, which is never preempted anyway. */
+  if (++thread_ticks >= TIME_SLICE && intr_context ())
     intr_yield_on_return ();
 
   #ifndef USERPROG
@@ -189,6 +246,35 @@ thread_print_stats (void)
 {
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
+
+  if (thread_schedstat)
+    {
+      struct list_elem *e;
+      int b;
+
+      for (e = list_begin (&all_list); e != list_end (&all_list);
+           e = list_next (e))
+        thread_print_sched (list_entry (e, struct thread, allelem));
+
+      printf ("Latency:");
+      for (b = 0; b < LATENCY_BUCKETS; b++)
+        if (b == 0)
+          printf (" 0: %u,", latency_hist[b]);
+        else if (b < LATENCY_BUCKETS - 1)
+          printf (" %d-%d: %u,", 1 << (b - 1), (1 << b) - 1, latency_hist[b]);
+        else
+          printf (" %d+: %u ticks\n", 1 << (b - 1), latency_hist[b]);
+    }
+}
+
+/* Prints T's scheduler statistics. */
+static void
+thread_print_sched (struct thread *t) 
+{
+  printf ("%s: %"PRId64" run ticks, %"PRId64" ready ticks, "
+          "%u voluntary and %u involuntary switches\n",
+          t->name, t->run_ticks, t->ready_ticks,
+          t->vol_switches, t->invol_switches);
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -221,7 +307,7 @@ thread_create (const char *name, int priority,
   struct thread *cur = thread_current();
 
   /* Allocate thread. */
-  t = palloc_get_page (PAL_ZERO);
+  t = thread_page_get ();
   if (t == NULL) 
     return TID_ERROR;
 
@@ -235,6 +321,7 @@ thread_create (const char *name, int priority,
   /* Set nice and recent_cpu value */
   t->nice = cur->nice;
   t->recent_cpu = cur->recent_cpu;
+  t->cpu_epoch = cur->cpu_epoch;
 
   /* Stack frame for kernel_thread(). */
   kf = alloc_frame (t, sizeof *kf);
@@ -298,10 +385,16 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  // list_push_back (&ready_list, &t->elem);
-  /* Unblocked thread's priroity is higher than RUNNING thread
-     Change RUNNING thread to new unblocked thread*/
-  list_insert_ordered(&ready_list, &t->elem, priority_ordered, NULL);
+#ifndef USERPROG
+  /* Apply the recent_cpu decay missed while blocked */
+  if (thread_mlfqs)
+    {
+      cal_recent_cpu (t);
+      cal_priority (t);
+    }
+#endif
+  t->ready_since = timer_ticks ();
+  ready_push (t);
   t->status = THREAD_READY;
   intr_set_level (old_level);
 }
@@ -350,6 +443,9 @@ thread_exit (void)
   process_exit ();
 #endif
 
+  if (thread_schedstat)
+    thread_print_sched (thread_current ());
+
   /* Remove thread from all threads list, set our status to dying,
      and schedule another process.  That process will destroy us
      when it calls thread_schedule_tail(). */
@@ -372,7 +468,10 @@ thread_yield (void)
 
   old_level = intr_disable ();
   if (cur != idle_thread) 
-    list_insert_ordered(&ready_list, &cur->elem, priority_ordered, NULL);
+    {
+      cur->ready_since = timer_ticks ();
+      ready_push (cur);
+    }
   cur->status = THREAD_READY;
   schedule ();
   intr_set_level (old_level);
@@ -403,7 +502,9 @@ thread_set_priority (int new_priority)
   old_level = intr_disable();
 
   struct thread *cur = thread_current ();
-  cur->priority = new_priority;
+  cur->init_priority = new_priority;
+  /* Donations still apply on top of the new base priority */
+  thread_refresh_priority();
 
   intr_set_level(old_level);
 
@@ -487,61 +588,114 @@ thread_get_recent_cpu (void)
 
 /* Project 3 */
 /* Sleeping threads */
+static bool sleep_less(const struct list_elem *a_, const struct list_elem *b_,
+                       void *aux UNUSED) {
+  const struct thread *a = list_entry(a_, struct thread, elem);
+  const struct thread *b = list_entry(b_, struct thread, elem);
+  return a->sleep_time < b->sleep_time;
+}
+/* Blocks the current thread until tick TICKS */
 void thread_sleep(int64_t ticks) {
   struct thread *cur = thread_current();
   enum intr_level old_level;
 
   old_level = intr_disable();
 
-  cur->sleep_time = ticks;
-
-  /* Insert sleep_list by priority */
-  list_insert_ordered(&sleep_list, &cur->elem, priority_ordered, NULL);
-  thread_block();
+  /* Its slot may already have been passed */
+  if(ticks > sleep_wheel_now) {
+    cur->sleep_time = ticks;
+    list_insert_ordered(&sleep_wheel[(unsigned) ticks & (SLEEP_WHEEL_SIZE - 1)],
+                        &cur->elem, sleep_less, NULL);
+    thread_block();
+  }
 
   intr_set_level(old_level);
 }
-/* Wake up sleeping thread */
+/* Wake up the threads due by tick TICKS
+   Visits each slot passed since the last call, only once */
 void thread_wake(int64_t ticks) {
+  int64_t t = sleep_wheel_now + 1;
+
+  if(ticks - t >= SLEEP_WHEEL_SIZE)
+    t = ticks - SLEEP_WHEEL_SIZE + 1;
+
+  for(; t <= ticks; t++) {
+    struct list *slot = &sleep_wheel[(unsigned) t & (SLEEP_WHEEL_SIZE - 1)];
+
+    while(!list_empty(slot)) {
+      struct thread *th = list_entry(list_front(slot), struct thread, elem);
+      if(th->sleep_time > ticks)
+        break;
+      list_pop_front(slot);
+      thread_unblock(th);
+    }
+  }
+  sleep_wheel_now = ticks;
+}
+/* Priority donation */
+/* Raise T's priority to PRIORITY, which is higher, on behalf of a
+   thread waiting for a lock T holds.  If T is waiting itself, its
+   place among the waiters is fixed up.  T can be ready and still
+   queued as a waiter: cond_wait() queues it before releasing the
+   lock, which may yield
+   Must be called with interrupts off */
+void thread_donate_priority(struct thread *t, int priority) {
+  int old_priority = t->priority;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+  ASSERT(priority > old_priority);
+
+  t->priority = priority;
+  if(t->status == THREAD_READY)
+    ready_move(t, old_priority);
+  if(t->wait_heap != NULL)
+    heap_increase(t->wait_heap, &t->wait_elem);
+}
+/* Recompute the current thread's priority from its own priority
+   and what is still donated through the locks it holds
+   Must be called with interrupts off */
+void thread_refresh_priority(void) {
   struct thread *cur = thread_current();
   struct list_elem *e;
 
-  bool flag = false;
-
-  for(e = list_begin(&sleep_list);
-      e != list_end(&sleep_list);
-      ) {
-        struct thread *t = list_entry(e, struct thread, elem);
-        /* Check time to wake up */
-        if(t->sleep_time <= ticks) {
-          e = list_remove(&t->elem);
-          // printf("%s: wake up\n", t->name);
-          flag = true;
-          thread_unblock(t);
-        }
-        else {
-          e = list_next(e);
-        }
-      }
-  // if(flag)
-    // try_thread_yield();
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  cur->priority = cur->init_priority;
+  for(e = list_begin(&cur->held_locks);
+      e != list_end(&cur->held_locks);
+      e = list_next(e)) {
+    struct lock *l = list_entry(e, struct lock, elem);
+    if(l->max_priority > cur->priority)
+      cur->priority = l->max_priority;
+  }
+}
+/* Returns the tick at which the next sleeping thread wakes up,
+   or INT64_MAX if no thread is sleeping
+   Must be called with interrupts off */
+int64_t thread_next_wakeup(void) {
+  int64_t next = INT64_MAX;
+  int i;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  for(i = 0; i < SLEEP_WHEEL_SIZE; i++)
+    if(!list_empty(&sleep_wheel[i])) {
+      struct thread *t = list_entry(list_front(&sleep_wheel[i]), struct thread, elem);
+      if(t->sleep_time < next)
+        next = t->sleep_time;
+    }
+  return next;
 }
 #ifndef USERPROG
-/* Calculate priority */
+/* Calculate priority
+   Only the running thread's recent_cpu changes between seconds,
+   so it is the only one to recalculate here.  Ready threads are
+   recalculated by cal_recent_cpu_all(), blocked ones on wake up */
 void cal_priority_all() {
   enum intr_level old_level;
   old_level = intr_disable();
 
-  struct list_elem *e;
-  for(e = list_begin(&all_list);
-      e != list_end(&all_list);
-      e = list_next(e))
-      {
-        struct thread *t = list_entry(e, struct thread, allelem);
-        cal_priority(t);
-      }
-  list_sort(&ready_list, priority_ordered, NULL);
-  list_sort(&sleep_list, priority_ordered, NULL);
+  cal_priority(thread_current());
 
   intr_set_level(old_level);
 
@@ -557,29 +711,53 @@ void cal_priority(struct thread * t) {
   else if(t->priority < PRI_MIN)
     t->priority = PRI_MIN;
 }
-/* Calculate recent_cpu */
+/* Calculate recent_cpu, once per second
+   Records this second's decay, then applies it to the running
+   and ready threads.  Blocked threads catch up in thread_unblock() */
 void cal_recent_cpu_all() {
   enum intr_level old_level;
   old_level = intr_disable();
 
-  struct list_elem *e;
-  for(e = list_begin(&all_list);
-      e != list_end(&all_list);
-      e = list_next(e))
-      {
-        struct thread *t = list_entry(e, struct thread, allelem);
-        cal_recent_cpu(t);
-      }
-    
+  struct list ready;
+  int p;
+
+  // coef = (2 * load_avg) / (2 * load_avg + 1);
+  decay_coef[decay_epoch % DECAY_RING] = F_DIV(F_MUL(F_INIT(2), load_avg),
+                                               F_ADD(F_MUL(F_INIT(2), load_avg),
+                                                     F_INIT(1)));
+  decay_epoch++;
+
+  cal_recent_cpu(thread_current());
+
+  /* Requeue every ready thread at its new priority */
+  list_init(&ready);
+  for(p = PRI_MAX; p >= PRI_MIN; p--)
+    list_splice(list_end(&ready), list_begin(&ready_queues[p]),
+                list_end(&ready_queues[p]));
+  memset(ready_mask, 0, sizeof ready_mask);
+  ready_cnt = 0;
+  while(!list_empty(&ready)) {
+    struct thread *t = list_entry(list_pop_front(&ready), struct thread, elem);
+    cal_recent_cpu(t);
+    cal_priority(t);
+    ready_push(t);
+  }
+
   intr_set_level(old_level);
 }
+/* Bring T's recent_cpu up to date, applying each second's decay
+   it has missed while blocked.  Decays older than DECAY_RING
+   seconds are lost; their weight by then is negligible */
 void cal_recent_cpu(struct thread *t) {
-  // cur->recent_cpu = (2 * load_avg) / (2 * load_avg + 1) * cur->recent_cpu + cur->nice;
-  t->recent_cpu = F_ADD(F_MUL(F_DIV(F_MUL(F_INIT(2), load_avg),
-                                    F_ADD(F_MUL(F_INIT(2), load_avg),
-                                          F_INIT(1))),
-                              t->recent_cpu),
-                        F_INIT(t->nice));
+  int e = t->cpu_epoch;
+
+  if(decay_epoch - e > DECAY_RING)
+    e = decay_epoch - DECAY_RING;
+  for(; e < decay_epoch; e++)
+    // cur->recent_cpu = (2 * load_avg) / (2 * load_avg + 1) * cur->recent_cpu + cur->nice;
+    t->recent_cpu = F_ADD(F_MUL(decay_coef[e % DECAY_RING], t->recent_cpu),
+                          F_INIT(t->nice));
+  t->cpu_epoch = decay_epoch;
 }
 /* Calculate load_avg */
 void cal_load_avg() {
@@ -588,10 +766,10 @@ void cal_load_avg() {
 
   int ready_thread;
   if(thread_current() == idle_thread)
-    ready_thread = list_size(&ready_list);
+    ready_thread = ready_cnt;
   else
-    ready_thread = list_size(&ready_list) + 1;
-  // load_avg = (59 / 60) * load_avg + (1 / 60) * list_size(&ready_list);
+    ready_thread = ready_cnt + 1;
+  // load_avg = (59 / 60) * load_avg + (1 / 60) * ready_cnt;
   load_avg = F_ADD(F_MUL(F_DIV(F_INIT(59),
                                F_INIT(60)), 
                          load_avg),
@@ -636,7 +814,9 @@ idle (void *idle_started_ UNUSED)
 
          See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
          7.11.1 "HLT Instruction". */
+      timer_idle_enter ();
       asm volatile ("sti; hlt" : : : "memory");
+      timer_idle_exit ();
     }
 }
 
@@ -688,6 +868,9 @@ init_thread (struct thread *t, const char *name, int priority)
   strlcpy (t->name, name, sizeof t->name);
   t->stack = (uint8_t *) t + PGSIZE;
   t->priority = priority;
+  t->init_priority = priority;
+  list_init (&t->held_locks);
+  t->wait_heap = NULL;
   t->magic = THREAD_MAGIC;
 
   old_level = intr_disable ();
@@ -733,10 +916,63 @@ alloc_frame (struct thread *t, size_t size)
 static struct thread *
 next_thread_to_run (void) 
 {
-  if (list_empty (&ready_list))
+  if (ready_cnt == 0)
     return idle_thread;
   else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+    return ready_pop ();
+}
+
+/* Adds T to the back of the ready queue for its priority. */
+static void
+ready_push (struct thread *t)
+{
+  int p = t->priority;
+
+  list_push_back (&ready_queues[p], &t->elem);
+  ready_mask[p / 32] |= 1u << (p % 32);
+  ready_cnt++;
+}
+
+/* Removes and returns the first thread of the highest priority
+   nonempty ready queue, which must exist. */
+static struct thread *
+ready_pop (void)
+{
+  int p = ready_max_priority ();
+  struct thread *t;
+
+  ASSERT (p >= PRI_MIN);
+
+  t = list_entry (list_pop_front (&ready_queues[p]), struct thread, elem);
+  if (list_empty (&ready_queues[p]))
+    ready_mask[p / 32] &= ~(1u << (p % 32));
+  ready_cnt--;
+  return t;
+}
+
+/* Moves ready thread T, whose priority was OLD_PRIORITY, to the
+   back of the queue for its current priority. */
+static void
+ready_move (struct thread *t, int old_priority)
+{
+  list_remove (&t->elem);
+  if (list_empty (&ready_queues[old_priority]))
+    ready_mask[old_priority / 32] &= ~(1u << (old_priority % 32));
+  ready_cnt--;
+  ready_push (t);
+}
+
+/* Returns the highest priority of any ready thread, or -1 if no
+   thread is ready. */
+static int
+ready_max_priority (void)
+{
+  int i;
+
+  for (i = sizeof ready_mask / sizeof *ready_mask - 1; i >= 0; i--)
+    if (ready_mask[i] != 0)
+      return i * 32 + 31 - __builtin_clz (ready_mask[i]);
+  return -1;
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -781,7 +1017,7 @@ thread_schedule_tail (struct thread *prev)
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread) 
     {
       ASSERT (prev != cur);
-      palloc_free_page (prev);
+      thread_page_put (prev);
     }
 }
 
@@ -804,10 +1040,79 @@ schedule (void)
   ASSERT (is_thread (next));
 
   if (cur != next)
-    prev = switch_threads (cur, next);
+    {
+      sched_account (cur, next);
+      prev = switch_threads (cur, next);
+    }
   thread_schedule_tail (prev);
 }
 
+/* Returns a page for a new thread, from thread_cache if it has
+   one, or a null pointer if none is available.  The page is not
+   zeroed: init_thread() sets up all of struct thread and the
+   stack needs no initial contents. */
+static struct thread *
+thread_page_get (void) 
+{
+  struct thread *t = NULL;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  if (!list_empty (&thread_cache))
+    {
+      t = list_entry (list_pop_front (&thread_cache), struct thread, elem);
+      thread_cache_cnt--;
+    }
+  intr_set_level (old_level);
+
+  if (t == NULL)
+    t = palloc_get_page (0);
+  return t;
+}
+
+/* Keeps dead thread T's page in thread_cache, or frees it if the
+   cache is full.  Must be called with interrupts off, since it
+   runs in thread_schedule_tail(). */
+static void
+thread_page_put (struct thread *t) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (thread_cache_cnt < THREAD_CACHE_MAX)
+    {
+      list_push_front (&thread_cache, &t->elem);
+      thread_cache_cnt++;
+    }
+  else
+    palloc_free_page (t);
+}
+
+/* Updates scheduler statistics for a switch from CUR to NEXT.
+   CUR's switch is voluntary if it is blocking, involuntary if it
+   stays ready, and not counted if it is dying. */
+static void
+sched_account (struct thread *cur, struct thread *next) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (cur->status == THREAD_BLOCKED)
+    cur->vol_switches++;
+  else if (cur->status == THREAD_READY)
+    cur->invol_switches++;
+
+  /* The idle thread runs only when nothing else is ready. */
+  if (next != idle_thread)
+    {
+      int64_t wait = timer_ticks () - next->ready_since;
+      int b = 0;
+
+      next->ready_ticks += wait;
+      while (b < LATENCY_BUCKETS - 1 && wait >= (1 << b))
+        b++;
+      latency_hist[b]++;
+    }
+}
+
 /* Returns a tid to use for a new thread. */
 static tid_t
 allocate_tid (void) 
@@ -857,22 +1162,27 @@ bool priority_ordered(struct list_elem *elem, struct list_elem *e, void *aux) {
    This function is called READY thread's priority
    can be higher than RUNNING thread's priority */
 void try_thread_yield() {
-  if(running_thread() != idle_thread && !list_empty(&ready_list)) {
-    if(thread_current()->priority < list_entry(list_front(&ready_list), struct thread, elem)->priority)
+  if(running_thread() != idle_thread && ready_cnt > 0) {
+    if(thread_current()->priority < ready_max_priority())
       thread_yield();
   }
 }
 #ifndef USERPROG
+/* Raise every ready thread's priority by one, a whole queue at a
+   time, from the top down so that no thread moves twice */
 void thread_aging() {
-  struct list_elem *e;
-  for(e = list_begin(&ready_list);
-      e != list_end(&ready_list);
-      e = list_next(e))
-      {
-        struct thread *t = list_entry(e, struct thread, elem);
-        if(t != idle_thread)
-          if(t->priority < PRI_MAX)
-            t->priority++;
-      }
+  int p;
+  for(p = PRI_MAX - 1; p >= PRI_MIN; p--) {
+    struct list *q = &ready_queues[p];
+    struct list_elem *e;
+
+    if(list_empty(q))
+      continue;
+    for(e = list_begin(q); e != list_end(q); e = list_next(e))
+      list_entry(e, struct thread, elem)->priority++;
+    list_splice(list_end(&ready_queues[p + 1]), list_begin(q), list_end(q));
+    ready_mask[p / 32] &= ~(1u << (p % 32));
+    ready_mask[(p + 1) / 32] |= 1u << ((p + 1) % 32);
+  }
 }
 #endif
\ No newline at end of file
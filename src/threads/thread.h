@@ -4,6 +4,7 @@
 #include <debug.h>
 #include <list.h>
 #include <stdint.h>
+#include <vmstat.h>
 
 /* Project 3 */
 #include "threads/synch.h"
@@ -131,15 +132,33 @@ struct thread
     struct file *fd[MAX_FD];            /* File descriptor */
 
     /* Proj 3 */
-    int sleep_time;                     /* Tick arrives sleep_time, wake up */
+    int init_priority;                  /* Priority before donation */
+    struct lock *wait_on_lock;          /* Lock being waited for */
+    struct list held_locks;             /* Locks held, for donation */
+    struct heap *wait_heap;             /* Waiters heap we are in, if any */
+    struct heap_elem wait_elem;         /* Element in wait_heap */
+    int64_t sleep_time;                 /* Tick arrives sleep_time, wake up */
     int nice;                           /* Calculate priority */
     FIXED recent_cpu;                     /* Calculate priority */
+    int cpu_epoch;                      /* Seconds of decay in recent_cpu */
 
     /* Proj 4 */
     struct hash vm;                     /* Hash table */
     struct file *loaded_file;           /* Buf fix for syn-read, syn-write*/
     int mapid;                          /* mmap id */
     struct list mmap_list;
+    void *esp;                          /* User esp at syscall entry */
+    void *fa_next;                      /* Fault here continues a scan */
+    size_t fa_window;                   /* Fault-around window, in pages */
+    struct vmstat vmstat;               /* Paging statistics */
+    int64_t start_ticks;                /* Timer ticks at process start */
+
+    /* Scheduler statistics, see thread_print_stats(). */
+    int64_t run_ticks;                  /* Timer ticks spent running */
+    int64_t ready_ticks;                /* Timer ticks spent ready */
+    int64_t ready_since;                /* Tick it last became ready */
+    unsigned vol_switches;              /* Switches away while blocking */
+    unsigned invol_switches;            /* Switches away while ready */
 
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
@@ -150,6 +169,11 @@ struct thread
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* If true, print each thread's scheduler statistics when it
+   exits, and all of them at shutdown.
+   Controlled by kernel command-line option "-schedstat". */
+extern bool thread_schedstat;
+
 void thread_init (void);
 void thread_start (void);
 
@@ -187,6 +211,9 @@ struct thread *searchChild(tid_t child_tid);
 /* Project 3 */
 void thread_sleep(int64_t ticks);
 void thread_wake(int64_t ticks);
+int64_t thread_next_wakeup(void);
+void thread_donate_priority(struct thread *t, int priority);
+void thread_refresh_priority(void);
 void cal_priority_all();
 void cal_priority();
 void cal_recent_cpu_all();
@@ -144,6 +144,7 @@ page_fault (struct intr_frame *f)
 
   /* Count page faults. */
   page_fault_cnt++;
+  thread_current ()->vmstat.faults++;
 
   /* Determine cause. */
   not_present = (f->error_code & PF_P) == 0;
@@ -161,8 +162,14 @@ page_fault (struct intr_frame *f)
 
   struct vm_entry *vme = find_vme(fault_addr);
   if (vme == NULL) {
-   // printf("vme is NULL\n");
-   sys_exit(-1);
+   /* A fault inside a system call sees the kernel esp in F,
+      so use the user esp saved at syscall entry */
+   void *esp = user ? f->esp : thread_current()->esp;
+
+   if (is_stack_access(fault_addr, esp))
+     vme = expand_stack(fault_addr);
+   if (vme == NULL)
+     sys_exit(-1);
   }
 //   printf("vme not NULL\n");
 
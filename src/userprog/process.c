@@ -7,6 +7,7 @@
 #include <string.h>
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
+#include "userprog/syscall.h"
 #include "userprog/tss.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
@@ -14,17 +15,27 @@
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
 
 static thread_func start_process NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
+static bool load_page (struct vm_entry *vme);
+
+enum load_policy load_policy = LOAD_LAZY;
+bool load_report_faults;
+bool print_vmstat;
 
 /* Starts a new thread running a user program loaded from
-   FILENAME.  The new thread may be scheduled (and may even exit)
-   before process_execute() returns.  Returns the new process's
-   thread id, or TID_ERROR if the thread cannot be created. */
+   FILENAME, with its pages loaded as load_policy says.  The new
+   thread may be scheduled (and may even exit) before
+   process_execute() returns.  Returns the new process's thread
+   id, or TID_ERROR if the thread cannot be created. */
 tid_t
 process_execute (const char *file_name) 
 {
@@ -91,6 +102,7 @@ start_process (void *file_name_)
 
   /* Proj 4 */
   vm_init(&thread_current()->vm);
+  thread_current()->start_ticks = timer_ticks();
 
   /* Initialize interrupt frame and load executable. */
   memset (&if_, 0, sizeof if_);
@@ -151,8 +163,18 @@ process_exit (void)
   struct thread *cur = thread_current ();
   uint32_t *pd;
 
-  if(cur->loaded_file != NULL)
-    file_close(cur->loaded_file);
+  if (load_report_faults && cur->pagedir != NULL)
+    printf ("%s: %u page faults, %"PRId64" ticks\n", cur->name,
+            cur->vmstat.faults, timer_elapsed (cur->start_ticks));
+  if (print_vmstat && cur->pagedir != NULL)
+    {
+      const struct vmstat *st = &cur->vmstat;
+
+      printf ("%s: vmstat: %u faults, %u file loads, %u zero fills, "
+              "%u swap ins, %u evictions, %u write-backs\n", cur->name,
+              st->faults, st->file_loads, st->zero_fills, st->swap_ins,
+              st->evictions, st->write_backs);
+    }
 
   /* Close file descriptor for exiting process */
   for(int i = 2; i < MAX_FD; i++) {
@@ -161,8 +183,12 @@ process_exit (void)
     }
   }  
 
-  for(int i = 0; i < cur->mapid; i++) {
-    sys_munmap(i);
+  /* Write back and unmap every mapping still open */
+  while (!list_empty(&cur->mmap_list)) {
+    struct mmap_file *mmap_file = list_entry(list_pop_front(&cur->mmap_list),
+                                             struct mmap_file, elem);
+    do_munmap(mmap_file);
+    free(mmap_file);
   }
 
   sema_up(&cur->sema_wait);
@@ -171,6 +197,10 @@ process_exit (void)
 
   vm_destroy(&cur->vm);
 
+  /* Only now, as shared text pages are keyed by its inode */
+  if(cur->loaded_file != NULL)
+    file_close(cur->loaded_file);
+
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
   pd = cur->pagedir;
@@ -609,6 +639,10 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       if(!insert_vme(&thread_current()->vm, vme))
         return false;
 
+      /* Eager policy: read it in now, in file order */
+      if (load_policy == LOAD_EAGER && !load_page (vme))
+        return false;
+
       /* Advance. */
       read_bytes -= page_read_bytes;
       zero_bytes -= page_zero_bytes;
@@ -623,40 +657,45 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 static bool
 setup_stack (void **esp) 
 {
-  uint8_t *kpage;
+  struct frame *frame;
   bool success = false;
 
-  kpage = palloc_get_page (PAL_USER | PAL_ZERO);
-  if (kpage != NULL) 
-    {
-      success = install_page (((uint8_t *) PHYS_BASE) - PGSIZE, kpage, true);
-      if (success)
-        *esp = PHYS_BASE;
-      else
-        palloc_free_page (kpage);
-    }
-
   struct vm_entry *vme = (struct vm_entry *)malloc(sizeof(struct vm_entry));
   if (vme == NULL)
     return false;
     
   memset(vme, 0, sizeof(struct vm_entry));
 
-  // vme->type = VM_ANON;
-  /* ?? */
-  vme->type = VM_BIN;
+  vme->type = VM_ANON;
   vme->vaddr = ((uint8_t *) PHYS_BASE) - PGSIZE;
-  vme->writeable = success;
-  vme->is_loaded = success;
+  vme->writeable = true;
+  vme->is_loaded = false;
   vme->vm_file = NULL;
   vme->offset = 0;
   vme->read_bytes = 0;
-  vme->zero_bytes = 0;
+  vme->zero_bytes = PGSIZE;
+  vme->swap_slot = SWAP_SLOT_NONE;
 
-  if(!insert_vme(&thread_current()->vm, vme)) {
+  frame = frame_alloc (PAL_USER | PAL_ZERO, vme);
+  if (frame != NULL) 
+    {
+      success = install_page (vme->vaddr, frame->kaddr, true);
+      if (success)
+        *esp = PHYS_BASE;
+      else
+        frame_free (frame);
+    }
+
+  if(!success || !insert_vme(&thread_current()->vm, vme)) {
+    if (success)
+      {
+        pagedir_clear_page (thread_current ()->pagedir, vme->vaddr);
+        frame_free (frame);
+      }
     free(vme);
     return false;
   }
+  frame_insert (frame);
 
   return success;
 }
@@ -681,41 +720,131 @@ install_page (void *upage, void *kpage, bool writable)
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
 
-bool handle_mm_fault(struct vm_entry *vme) {
-  // printf("handle_mm_fault\n");
-  uint8_t *kpage = palloc_get_page (PAL_USER);
+/* Populates up to WINDOW - 1 pages that follow VME and are
+   backed by the next pages of the same file, stopping at the
+   first page that is already loaded or not contiguous on disk.
+   Never evicts: if the user pool is full, the window just ends
+   early.  Returns the number of pages populated. */
+static size_t
+fault_around (struct vm_entry *vme, size_t window)
+{
+  size_t i;
+
+  for (i = 1; i < window; i++)
+    {
+      struct vm_entry *next = find_vme ((uint8_t *) vme->vaddr + i * PGSIZE);
+      struct frame *frame;
+
+      if (next == NULL || next->is_loaded || next->type != vme->type
+          || next->vm_file != vme->vm_file
+          || next->offset != vme->offset + i * PGSIZE)
+        break;
+
+      if (vme_is_shareable (next))
+        {
+          if (!frame_share_map (next, false))
+            break;
+          continue;
+        }
+
+      frame = frame_try_alloc (PAL_USER, next);
+      if (frame == NULL)
+        break;
+      if (!load_file (frame->kaddr, next)
+          || !install_page (next->vaddr, frame->kaddr, next->writeable))
+        {
+          frame_free (frame);
+          break;
+        }
+      frame_insert (frame);
+      thread_current ()->vmstat.file_loads++;
+    }
+  return i - 1;
+}
 
-  if (kpage == NULL)
+/* Reads VME into a frame of its own and maps it. */
+static bool
+load_private_page (struct vm_entry *vme)
+{
+  /* Evicts another page if the user pool is exhausted */
+  struct frame *frame = frame_alloc (PAL_USER, vme);
+  struct vmstat *st = &thread_current ()->vmstat;
+
+  if (frame == NULL)
     return false;
 
+  /* Faulted while the page was being evicted, and the eviction
+     gave up and mapped it back: nothing left to load. */
+  if (vme->is_loaded) {
+    frame_free (frame);
+    return true;
+  }
+
   switch (vme->type) {
     case VM_BIN:
-      if (!load_file(kpage, vme)) {
-        palloc_free_page (kpage);
-        return false;
-      }
-      if (!install_page(vme->vaddr, kpage, vme->writeable)) {
-        palloc_free_page (kpage);
+    case VM_FILE:
+      if (!load_file(frame->kaddr, vme)) {
+        frame_free (frame);
         return false;
       }
-      vme->is_loaded = true;
+      st->file_loads++;
       break;
-    case VM_FILE:
-      if (!load_file(kpage, vme)) {
-          palloc_free_page (kpage);
-          vme->is_loaded = false;
-          return false;
-        }
-        if (!install_page(vme->vaddr, kpage, vme->writeable)) {
-          palloc_free_page (kpage);
-          vme->is_loaded = false;
-          return false;
-        }
-        vme->is_loaded = true;
+    case VM_ANON:
+      /* Never written out: demand-zero page */
+      if (vme->swap_slot == SWAP_SLOT_NONE) {
+        memset (frame->kaddr, 0, PGSIZE);
+        st->zero_fills++;
+      }
+      else {
+        swap_in (vme->swap_slot, frame->kaddr);
+        vme->swap_slot = SWAP_SLOT_NONE;
+        st->swap_ins++;
+      }
       break;
+    default:
+      frame_free (frame);
+      return false;
   }
 
-  // printf("find true\n");
+  if (!install_page(vme->vaddr, frame->kaddr, vme->writeable)) {
+    frame_free (frame);
+    return false;
+  }
+  frame_insert (frame);
+  return true;
+}
+
+/* Brings VME into memory and maps it.  Read-only text is shared
+   with other runs of the same executable. */
+static bool
+load_page (struct vm_entry *vme)
+{
+  if (vme_is_shareable (vme))
+    return frame_share_map (vme, true);
+  return load_private_page (vme);
+}
+
+bool handle_mm_fault(struct vm_entry *vme) {
+  struct thread *t = thread_current ();
+  size_t window;
+
+  if (!load_page (vme))
+    return false;
+
+  if (vme->type == VM_ANON)
+    return true;
+
+  /* Fault-around: a fault right past the last window means a
+     sequential scan, so double the window; anything else
+     starts over with just the faulting page */
+  window = vme->vaddr == t->fa_next ? t->fa_window * 2 : 1;
+  if (window > FAULT_AROUND_MAX)
+    window = FAULT_AROUND_MAX;
+  t->fa_window = window;
+
+  window = fault_around (vme, window);
+  vm_count_fault_around (window);
+  t->fa_next = (uint8_t *) vme->vaddr + (window + 1) * PGSIZE;
 
   return true;
-}
\ No newline at end of file
+}
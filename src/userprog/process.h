@@ -4,6 +4,21 @@
 #include "threads/thread.h"
 #include "vm/page.h"
 
+/* How load() brings in an executable's pages. */
+enum load_policy
+  {
+    LOAD_LAZY,                  /* Fault each page in on first use. */
+    LOAD_EAGER                  /* Read every page in during load(). */
+  };
+
+/* Load policy for every exec and whether to report page faults
+   at exit, set by the "-prefault" kernel option. */
+extern enum load_policy load_policy;
+extern bool load_report_faults;
+
+/* Print paging statistics at exit, set by "-vmstat". */
+extern bool print_vmstat;
+
 tid_t process_execute (const char *file_name);
 int process_wait (tid_t);
 void process_exit (void);
@@ -9,6 +9,7 @@
 
 #include "filesys/file.h"
 #include <inttypes.h>
+#include "vm/frame.h"
 
 static void syscall_handler (struct intr_frame *);
 void sys_halt (void) NO_RETURN;
@@ -27,6 +28,7 @@ void sys_close (int fd);
 int sys_mmap (int fd, void *addr);
 void sys_munmap (int mapid);
 void do_munmap(struct mmap_file *mmap_file);
+void sys_vmstat (struct vmstat *st);
 /*
    All file system call have check file descriptor is valid
    Check fd < 2 or fd > MAX_FD
@@ -66,23 +68,19 @@ struct vm_entry *check_address (void *addr) {
   // printf("check address %p\n", addr);
   if (addr == NULL)
     sys_exit(-1);
-  if (addr < (void *)0x08048000 || addr >= (void *)PHYS_BASE)
+  if (addr < USER_BASE || addr >= (void *)PHYS_BASE)
     sys_exit(-1);
-  return find_vme(addr);
+
+  struct vm_entry *vme = find_vme(addr);
+  if (vme == NULL && is_stack_access(addr, thread_current()->esp))
+    vme = expand_stack(addr);
+  return vme;
 }
-/* Function for Read system call */
+/* Check every page of a user buffer in one pass.
+   TO_WRITE : the kernel stores into the buffer (read) */
 void check_valid_buffer (void *buffer,  unsigned size, bool to_write) {
-  // printf("buffer\n");
-  for (unsigned i = 0; i < size; i++) {
-    struct vm_entry *vme = check_address(buffer + i);
-    if(vme == NULL)
-      sys_exit(-1);
-    // if(to_write)
-    //   sys_exit(-1);
-    if(!vme->writeable)  
-      sys_exit(-1);
-  }
-  // printf("==buffer\n");
+  if (!vm_check_range(buffer, size, to_write, thread_current()->esp))
+    sys_exit(-1);
 }
 /* Function for Write system call */
 void check_valid_string (const void *str) {
@@ -312,7 +310,9 @@ int sys_mmap (int fd, void *addr) {
     }
 
     if (find_vme(addr) != NULL) {
-      sys_munmap(mmap_file->mapid);
+      /* Not on mmap_list yet: undo the pages mapped so far */
+      do_munmap(mmap_file);
+      free(mmap_file);
       return -1;
     }
     struct vm_entry *vme = (struct vm_entry *)malloc(sizeof(struct vm_entry));
@@ -358,40 +358,70 @@ void sys_munmap (int mapid) {
         }
       }
 }
+/* Writes LENGTH bytes of a mapping back to FILE at OFFSET,
+   straight from the user pages at UADDR */
+static void write_back_run(struct file *file, void *uaddr, off_t length, off_t offset) {
+  if (length > 0)
+    file_write_at(file, uaddr, length, offset);
+}
+
+/* Unmaps every page of MMAP_FILE and frees its frames.
+   Only loaded, dirty pages are written back, and each run of
+   adjacent dirty pages goes out in a single write */
 void do_munmap(struct mmap_file *mmap_file) {
   struct thread *cur = thread_current();
+  struct vm_entry *run = NULL;          /* First page of dirty run */
+  off_t run_bytes = 0;
+  unsigned dirty_cnt = 0;
   struct list_elem *e;
+
+  /* vme_list is in address order, which is also file order */
   for(e = list_begin(&mmap_file->vme_list);
       e != list_end(&mmap_file->vme_list);
-      )
+      e = list_next(e))
       {
-        // printf("do munmap\n");
         struct vm_entry *vme = list_entry(e, struct vm_entry, mmap_elem);
-        // printf("do munmap find %d\n", vme->read_bytes);
-        // if(vme->is_loaded) {
-          if(pagedir_is_dirty(cur->pagedir, vme->vaddr)) {
-            // lock_acquire(&syscall_lock);
-            file_write_at(vme->vm_file, vme->vaddr, vme->read_bytes, vme->offset);
-            // lock_release(&syscall_lock);
+        bool dirty = vme->is_loaded && pagedir_is_dirty(cur->pagedir, vme->vaddr);
+
+        if (run != NULL && (!dirty || run->offset + run_bytes != vme->offset)) {
+          write_back_run(mmap_file->mm_file, run->vaddr, run_bytes, run->offset);
+          run = NULL;
+        }
+        if (dirty) {
+          if (run == NULL) {
+            run = vme;
+            run_bytes = 0;
           }
-          // palloc_free_page(pagedir_get_page(cur->pagedir, vme->vaddr));
-        // }
-        e = list_remove(&vme->mmap_elem);
-        delete_vme(&cur->vm, vme);
-        free(vme);
-        // printf("do munmap free\n");
+          run_bytes += vme->read_bytes;
+          dirty_cnt++;
+        }
       }
+  if (run != NULL)
+    write_back_run(mmap_file->mm_file, run->vaddr, run_bytes, run->offset);
+  cur->vmstat.write_backs += dirty_cnt;
+
+  while (!list_empty(&mmap_file->vme_list)) {
+    struct vm_entry *vme = list_entry(list_pop_front(&mmap_file->vme_list),
+                                      struct vm_entry, mmap_elem);
+    frame_unmap(vme);
+    delete_vme(&cur->vm, vme);
+    free(vme);
+  }
 
-  // lock_acquire(&syscall_lock);
-  // file_close(mmap_file->mm_file);
-  // lock_release(&syscall_lock);
-  // printf("end do munmap\n");
+  file_close(mmap_file->mm_file);
+}
 
+/* Copy the paging statistics of this process to ST */
+void sys_vmstat (struct vmstat *st) {
+  *st = thread_current()->vmstat;
 }
 
 static void
 syscall_handler (struct intr_frame *f UNUSED) 
 {
+  /* Page faults in kernel mode need the user stack pointer */
+  thread_current()->esp = f->esp;
+
   check_address(f->esp);
 
   // printf("syscall handler\n");
@@ -450,7 +480,7 @@ syscall_handler (struct intr_frame *f UNUSED)
       check_address((void *)(f->esp + 4));
       check_address((void *)(f->esp + 8));
       check_address((void *)(f->esp + 12));
-      check_valid_buffer(*(char **)(f->esp + 8), *(unsigned *)(f->esp + 12), false);
+      check_valid_buffer(*(char **)(f->esp + 8), *(unsigned *)(f->esp + 12), true);
       int result = sys_read(*(int *)(f->esp + 4), *(void **)(f->esp + 8), *(unsigned *)(f->esp + 12));
       f->eax = result;
       break;
@@ -461,7 +491,7 @@ syscall_handler (struct intr_frame *f UNUSED)
       check_address((void *)(f->esp + 4));
       check_address((void *)(f->esp + 8));
       check_address((void *)(f->esp + 12));
-      check_valid_string(*(char **)(f->esp + 8));
+      check_valid_buffer(*(char **)(f->esp + 8), *(unsigned *)(f->esp + 12), false);
       f->eax = sys_write(*(int *)(f->esp + 4), *(void **)(f->esp + 8), *(unsigned *)(f->esp + 12));
       break;
     case SYS_SEEK:                   /* Change position in a file. */
@@ -500,5 +530,11 @@ syscall_handler (struct intr_frame *f UNUSED)
     case SYS_ISDIR:                  /* Tests if a fd represents a directory. */
     case SYS_INUMBER:
       break;
+    /* Paging statistics. */
+    case SYS_VMSTAT:                 /* Reports this process's paging stats. */
+      check_address((void *)(f->esp + 4));
+      check_valid_buffer(*(void **)(f->esp + 4), sizeof (struct vmstat), true);
+      sys_vmstat(*(struct vmstat **)(f->esp + 4));
+      break;
   }
 }
@@ -1,6 +1,9 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 
+struct mmap_file;
+
 void syscall_init (void);
+void do_munmap (struct mmap_file *mmap_file);
 
 #endif /* userprog/syscall.h */
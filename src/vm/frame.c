@@ -0,0 +1,494 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include "filesys/file.h"
+#include "threads/interrupt.h"
+#include "threads/loader.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+#include "userprog/pagedir.h"
+#include "vm/swap.h"
+
+/* Frame table, one entry per page of physical memory,
+   indexed by physical page number. */
+static struct frame *frame_table;
+
+/* Frames that hold a user page and may be evicted, in the order
+   the clock hand visits them. */
+static struct list lru_list;
+static struct list_elem *lru_clock;
+
+/* Page cleaner's position in lru_list.  It runs its own hand so
+   that each pass looks at frames the last one did not. */
+static struct list_elem *clean_clock;
+
+int64_t clean_interval = CLEAN_INTERVAL_DEFAULT;
+size_t clean_batch = CLEAN_BATCH_DEFAULT;
+
+/* Shared read-only executable pages, keyed by inode, offset and
+   length. */
+static struct hash share_table;
+
+/* Protects lru_list, lru_clock, share_table and the frame table
+   entries. */
+static struct lock lru_lock;
+
+static struct frame *frame_lookup (void *kaddr) {
+    return &frame_table[vtop (kaddr) >> PGBITS];
+}
+
+static unsigned share_hash_func (const struct hash_elem *e, void *aux UNUSED) {
+    const struct share *share = hash_entry (e, struct share, elem);
+
+    return hash_bytes (&share->inode, sizeof share->inode)
+           ^ hash_int (share->offset) ^ hash_int (share->read_bytes);
+}
+
+static bool share_less_func (const struct hash_elem *a_,
+                             const struct hash_elem *b_, void *aux UNUSED) {
+    const struct share *a = hash_entry (a_, struct share, elem);
+    const struct share *b = hash_entry (b_, struct share, elem);
+
+    if (a->inode != b->inode)
+        return a->inode < b->inode;
+    if (a->offset != b->offset)
+        return a->offset < b->offset;
+    return a->read_bytes < b->read_bytes;
+}
+
+/* Returns the share matching KEY's inode, offset and length, or
+   a null pointer if there is none.
+   Must be called with lru_lock held. */
+static struct share *share_find (struct share *key) {
+    struct hash_elem *e = hash_find (&share_table, &key->elem);
+
+    return e != NULL ? hash_entry (e, struct share, elem) : NULL;
+}
+
+/* Initializes the frame table.
+   Must be called after malloc_init(). */
+void frame_init (void) {
+    size_t i;
+
+    frame_table = calloc (init_ram_pages, sizeof *frame_table);
+    if (frame_table == NULL)
+        PANIC ("frame table allocation failed");
+    for (i = 0; i < init_ram_pages; i++)
+        frame_table[i].kaddr = ptov (i * PGSIZE);
+
+    list_init (&lru_list);
+    lru_clock = NULL;
+    clean_clock = NULL;
+    hash_init (&share_table, share_hash_func, share_less_func, NULL);
+    lock_init (&lru_lock);
+}
+
+/* Removes FRAME from the clock list, moving the clock hands past
+   it first if necessary. */
+static void frame_remove (struct frame *frame) {
+    if (lru_clock == &frame->lru)
+        lru_clock = list_next (lru_clock);
+    if (clean_clock == &frame->lru)
+        clean_clock = list_next (clean_clock);
+    list_remove (&frame->lru);
+}
+
+/* Advances the clock hand and returns the frame it passed. */
+static struct frame *next_victim (void) {
+    struct frame *frame;
+
+    if (lru_clock == NULL || lru_clock == list_end (&lru_list))
+        lru_clock = list_begin (&lru_list);
+    frame = list_entry (lru_clock, struct frame, lru);
+    lru_clock = list_next (lru_clock);
+    return frame;
+}
+
+/* Writes FRAME's dirty page to its backing store.  The caller
+   owns the dirty bit: the page cleaner clears it beforehand, and
+   eviction has already unmapped the page.  File mappings go back
+   to their file.  Anything else goes to swap, over the page's
+   slot if it has one, and keeps the slot so that a later eviction
+   of the still clean page costs nothing.  A dirty executable page
+   becomes anonymous once it is in swap.
+   Returns false if the page cannot be written. */
+static bool frame_write_back (struct frame *frame) {
+    struct vm_entry *vme = frame->vme;
+    size_t slot;
+
+    if (vme->type == VM_FILE) {
+        file_write_at (vme->vm_file, frame->kaddr, vme->read_bytes,
+                       vme->offset);
+        frame->thread->vmstat.write_backs++;
+        return true;
+    }
+
+    if (vme->type == VM_ANON && vme->swap_slot != SWAP_SLOT_NONE) {
+        swap_write (vme->swap_slot, frame->kaddr);
+        frame->thread->vmstat.write_backs++;
+        return true;
+    }
+    slot = swap_out (frame->kaddr);
+    if (slot == SWAP_SLOT_NONE)
+        return false;
+    vme->swap_slot = slot;
+    vme->type = VM_ANON;
+    frame->thread->vmstat.write_backs++;
+    return true;
+}
+
+/* Writes FRAME's page to its backing store, if it needs one, so
+   that the frame can be dropped.  DIRTY is the page's dirty bit as
+   it was when the page was unmapped.  Clean executable pages are
+   simply re-read from the executable, and clean pages already
+   written out by the page cleaner are dropped as they are.
+   Returns false if the page cannot be saved. */
+static bool frame_save (struct frame *frame, bool dirty) {
+    struct vm_entry *vme = frame->vme;
+
+    if (dirty)
+        return frame_write_back (frame);
+
+    switch (vme->type) {
+        case VM_BIN:
+        case VM_FILE:
+            return true;
+        case VM_ANON:
+            /* Never written out, or changed since: must go to swap. */
+            if (vme->swap_slot == SWAP_SLOT_NONE)
+                return frame_write_back (frame);
+            return true;
+        default:
+            return false;
+    }
+}
+
+/* Returns true if any process sharing SHARE used it recently,
+   clearing the accessed bits for the next pass of the clock. */
+static bool share_accessed (struct share *share) {
+    bool accessed = false;
+    struct list_elem *e;
+
+    for (e = list_begin (&share->sharers); e != list_end (&share->sharers);
+         e = list_next (e)) {
+        struct vm_entry *vme = list_entry (e, struct vm_entry, share_elem);
+        uint32_t *pd = vme->owner->pagedir;
+
+        if (pagedir_is_accessed (pd, vme->vaddr)) {
+            pagedir_set_accessed (pd, vme->vaddr, false);
+            accessed = true;
+        }
+    }
+    return accessed;
+}
+
+/* Removes SHARE from the share table and frees it.  Its frame
+   becomes private again. */
+static void share_destroy (struct share *share) {
+    hash_delete (&share_table, &share->elem);
+    share->frame->share = NULL;
+    free (share);
+}
+
+/* Unmaps SHARE from every process sharing it and destroys it. */
+static void share_unmap_all (struct share *share) {
+    while (!list_empty (&share->sharers)) {
+        struct vm_entry *vme = list_entry (list_pop_front (&share->sharers),
+                                           struct vm_entry, share_elem);
+
+        pagedir_clear_page (vme->owner->pagedir, vme->vaddr);
+        vme->is_loaded = false;
+        vme->owner->vmstat.evictions++;
+    }
+    share_destroy (share);
+}
+
+/* Takes FRAME, which is no longer mapped, off the clock list and
+   returns it to the user pool. */
+static void frame_release (struct frame *frame) {
+    frame_remove (frame);
+    frame->vme = NULL;
+    frame->thread = NULL;
+    palloc_free_page (frame->kaddr);
+}
+
+/* Second-chance clock replacement.  Frees one frame and returns
+   true, or returns false if no page could be saved, e.g. because
+   swap is full.
+   Must be called with lru_lock held. */
+static bool frame_evict (void) {
+    size_t tries = 2 * list_size (&lru_list);
+
+    while (tries-- > 0) {
+        struct frame *frame = next_victim ();
+        struct vm_entry *vme = frame->vme;
+        enum intr_level old_level;
+        uint32_t *pd;
+        bool dirty;
+
+        /* Shared pages are read-only, so never need saving. */
+        if (frame->share != NULL) {
+            if (share_accessed (frame->share))
+                continue;
+            share_unmap_all (frame->share);
+            frame_release (frame);
+            return true;
+        }
+
+        /* Recently used: clear the bit and give it a second chance. */
+        pd = frame->thread->pagedir;
+        if (pagedir_is_accessed (pd, vme->vaddr)) {
+            pagedir_set_accessed (pd, vme->vaddr, false);
+            continue;
+        }
+
+        /* Unmap before writing out, so that a store made while the
+           write is in progress faults instead of being lost.  The
+           owner's fault waits for lru_lock. */
+        old_level = intr_disable ();
+        dirty = pagedir_is_dirty (pd, vme->vaddr);
+        pagedir_clear_page (pd, vme->vaddr);
+        intr_set_level (old_level);
+
+        if (!frame_save (frame, dirty)) {
+            pagedir_set_page (pd, vme->vaddr, frame->kaddr, vme->writeable);
+            pagedir_set_dirty (pd, vme->vaddr, dirty);
+            continue;
+        }
+        vme->is_loaded = false;
+        frame->thread->vmstat.evictions++;
+        frame_release (frame);
+        return true;
+    }
+    return false;
+}
+
+/* Allocates a frame from the user pool to hold VME for the
+   current thread.  If EVICT is true and the pool is full, evicts
+   another page to make room. */
+static struct frame *do_frame_alloc (enum palloc_flags flags,
+                                     struct vm_entry *vme, bool evict) {
+    struct frame *frame;
+    void *kaddr;
+
+    ASSERT (flags & PAL_USER);
+
+    lock_acquire (&lru_lock);
+    kaddr = palloc_get_page (flags);
+    while (kaddr == NULL && evict && frame_evict ())
+        kaddr = palloc_get_page (flags);
+    lock_release (&lru_lock);
+
+    if (kaddr == NULL)
+        return NULL;
+
+    frame = frame_lookup (kaddr);
+    frame->vme = vme;
+    frame->thread = thread_current ();
+    return frame;
+}
+
+/* Allocates a frame from the user pool to hold VME for the
+   current thread, evicting another page if the pool is full.
+   The frame is not visible to the clock until frame_insert() is
+   called, so it cannot be evicted while it is being filled.
+   Returns a null pointer if no frame could be freed. */
+struct frame *frame_alloc (enum palloc_flags flags, struct vm_entry *vme) {
+    return do_frame_alloc (flags, vme, true);
+}
+
+/* Like frame_alloc(), but returns a null pointer instead of
+   evicting when the user pool is full.  For speculative loads. */
+struct frame *frame_try_alloc (enum palloc_flags flags, struct vm_entry *vme) {
+    return do_frame_alloc (flags, vme, false);
+}
+
+/* Marks FRAME's page loaded and makes FRAME a candidate for
+   eviction.  The page must already be mapped by its owner. */
+void frame_insert (struct frame *frame) {
+    lock_acquire (&lru_lock);
+    frame->vme->is_loaded = true;
+    list_push_back (&lru_list, &frame->lru);
+    lock_release (&lru_lock);
+}
+
+/* Frees FRAME, which was never passed to frame_insert(). */
+void frame_free (struct frame *frame) {
+    frame->vme = NULL;
+    frame->thread = NULL;
+    palloc_free_page (frame->kaddr);
+}
+
+/* Unmaps VME from the current thread's page directory and frees
+   the frame holding it, if it is loaded.  A shared frame is only
+   freed when its last sharer unmaps it. */
+void frame_unmap (struct vm_entry *vme) {
+    uint32_t *pd = thread_current ()->pagedir;
+
+    lock_acquire (&lru_lock);
+    if (vme->is_loaded) {
+        struct frame *frame = frame_lookup (pagedir_get_page (pd, vme->vaddr));
+
+        pagedir_clear_page (pd, vme->vaddr);
+        vme->is_loaded = false;
+
+        if (frame->share != NULL) {
+            list_remove (&vme->share_elem);
+            if (list_empty (&frame->share->sharers)) {
+                share_destroy (frame->share);
+                frame_release (frame);
+            }
+        }
+        else
+            frame_release (frame);
+    }
+    lock_release (&lru_lock);
+}
+
+/* Maps SHARE's frame read-only at VME in the current process.
+   Must be called with lru_lock held. */
+static bool share_add (struct share *share, struct vm_entry *vme) {
+    struct thread *cur = thread_current ();
+
+    if (!pagedir_set_page (cur->pagedir, vme->vaddr, share->frame->kaddr,
+                           false))
+        return false;
+    vme->owner = cur;
+    vme->is_loaded = true;
+    list_push_back (&share->sharers, &vme->share_elem);
+    return true;
+}
+
+/* Maps the read-only executable page VME into the current
+   process, reusing the copy already in memory if another process
+   runs the same executable, or reading it in and publishing it
+   otherwise.  If EVICT is false, fails rather than evicting to
+   make room.  Returns true if successful. */
+bool frame_share_map (struct vm_entry *vme, bool evict) {
+    struct share key, *share, *new_share;
+    struct frame *frame;
+    bool success;
+
+    ASSERT (vme_is_shareable (vme));
+
+    key.inode = file_get_inode (vme->vm_file);
+    key.offset = vme->offset;
+    key.read_bytes = vme->read_bytes;
+
+    lock_acquire (&lru_lock);
+    share = share_find (&key);
+    if (share != NULL) {
+        success = share_add (share, vme);
+        lock_release (&lru_lock);
+        return success;
+    }
+    lock_release (&lru_lock);
+
+    /* Not resident: read a copy without holding the lock. */
+    frame = do_frame_alloc (PAL_USER, vme, evict);
+    if (frame == NULL)
+        return false;
+    new_share = malloc (sizeof *new_share);
+    if (new_share == NULL || !load_file (frame->kaddr, vme)) {
+        free (new_share);
+        frame_free (frame);
+        return false;
+    }
+    thread_current ()->vmstat.file_loads++;
+
+    /* Publish it, unless another process got there first. */
+    lock_acquire (&lru_lock);
+    share = share_find (&key);
+    if (share == NULL) {
+        share = new_share;
+        *share = key;
+        share->frame = frame;
+        list_init (&share->sharers);
+        hash_insert (&share_table, &share->elem);
+
+        frame->share = share;
+        frame->vme = NULL;
+        frame->thread = NULL;
+        list_push_back (&lru_list, &frame->lru);
+        new_share = NULL;
+        frame = NULL;
+    }
+    success = share_add (share, vme);
+    if (list_empty (&share->sharers)) {
+        struct frame *orphan = share->frame;
+
+        share_destroy (share);
+        frame_release (orphan);
+    }
+    lock_release (&lru_lock);
+
+    free (new_share);
+    if (frame != NULL)
+        frame_free (frame);
+    return success;
+}
+
+/* Makes one pass of the page cleaner over at most one lap of the
+   clock list, writing back up to clean_batch dirty pages.  Dirty
+   file mappings are always written; other pages only if they have
+   not been used recently, as those are the next eviction victims.
+   lru_lock is held for one page at a time, so faults can proceed
+   between writes. */
+static void frame_clean (void) {
+    size_t scanned, written = 0;
+
+    lock_acquire (&lru_lock);
+    for (scanned = list_size (&lru_list); scanned > 0 && written < clean_batch;
+         scanned--) {
+        struct frame *frame;
+        uint32_t *pd;
+
+        if (list_empty (&lru_list))
+            break;
+        if (clean_clock == NULL || clean_clock == list_end (&lru_list))
+            clean_clock = list_begin (&lru_list);
+        frame = list_entry (clean_clock, struct frame, lru);
+        clean_clock = list_next (clean_clock);
+
+        /* Shared pages are read-only and never dirty. */
+        if (frame->share != NULL)
+            continue;
+        pd = frame->thread->pagedir;
+        if (!pagedir_is_dirty (pd, frame->vme->vaddr))
+            continue;
+        if (frame->vme->type != VM_FILE
+            && pagedir_is_accessed (pd, frame->vme->vaddr))
+            continue;
+
+        /* Clear before writing: a store racing with the write
+           dirties the page again, and eviction samples the bit as
+           it unmaps the page, so the store is not lost. */
+        pagedir_set_dirty (pd, frame->vme->vaddr, false);
+        if (frame_write_back (frame))
+            written++;
+        else
+            pagedir_set_dirty (pd, frame->vme->vaddr, true);
+        lock_release (&lru_lock);
+        lock_acquire (&lru_lock);
+    }
+    lock_release (&lru_lock);
+}
+
+/* Page cleaner thread: cleans a batch of pages every
+   clean_interval ticks so that eviction rarely has to wait for a
+   write. */
+static void frame_cleaner (void *aux UNUSED) {
+    for (;;) {
+        timer_sleep (clean_interval);
+        frame_clean ();
+    }
+}
+
+/* Starts the page cleaner, unless disabled with a zero interval.
+   Must be called after the thread system and timer are up. */
+void frame_cleaner_start (void) {
+    if (clean_interval > 0 && clean_batch > 0)
+        thread_create ("pgclean", PRI_MIN, frame_cleaner, NULL);
+}
@@ -0,0 +1,54 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <hash.h>
+#include <list.h>
+#include "filesys/off_t.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "vm/page.h"
+
+/* A physical frame of the user pool.
+   There is one entry per page of physical memory; only frames
+   that back a user page are on the clock list. */
+struct frame {
+    void *kaddr;                        /* Kernel virtual address */
+    struct vm_entry *vme;               /* User page stored in this frame */
+    struct thread *thread;              /* Owner of VME */
+    struct share *share;                /* Non-null if shared, see below */
+
+    struct list_elem lru;               /* Element in clock list */
+};
+
+/* A read-only executable page shared by every process that maps
+   the same page of the same file.  The frame's VME and THREAD
+   are unused; instead each mapping vm_entry is on SHARERS, and
+   the frame is freed when the last one goes away. */
+struct share {
+    struct inode *inode;                /* Executable */
+    off_t offset;                       /* Page offset in INODE */
+    size_t read_bytes;                  /* Bytes read from INODE */
+
+    struct frame *frame;                /* Frame holding the page */
+    struct list sharers;                /* vm_entry share_elem list */
+    struct hash_elem elem;              /* Element in share table */
+};
+
+/* Page cleaner tuning, see frame_cleaner_start(). */
+#define CLEAN_INTERVAL_DEFAULT 100      /* Timer ticks between passes */
+#define CLEAN_BATCH_DEFAULT 32          /* Most pages written per pass */
+extern int64_t clean_interval;
+extern size_t clean_batch;
+
+void frame_init (void);
+void frame_cleaner_start (void);
+
+struct frame *frame_alloc (enum palloc_flags flags, struct vm_entry *vme);
+struct frame *frame_try_alloc (enum palloc_flags flags, struct vm_entry *vme);
+void frame_insert (struct frame *frame);
+void frame_free (struct frame *frame);
+void frame_unmap (struct vm_entry *vme);
+
+bool frame_share_map (struct vm_entry *vme, bool evict);
+
+#endif
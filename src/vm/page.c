@@ -1,4 +1,15 @@
 #include "vm/page.h"
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
+
+size_t stack_page_limit = STACK_LIMIT_DEFAULT;
+
+/* Fault-around statistics. */
+static long long file_fault_cnt;    /* # of VM_BIN and VM_FILE faults. */
+static long long fault_around_cnt;  /* # of pages populated around them. */
 
 
 static unsigned vm_hash_func (const struct hash_elem *e, void *aux) {
@@ -16,10 +27,9 @@ static bool vm_less_func (const struct hash_elem *a, const struct hash_elem *b,
 
 static void vm_destroy_func (struct hash_elem *e, void *aux) {
     struct vm_entry *vme = hash_entry(e, struct vm_entry, hash_elem);
-    if(vme->is_loaded) {
-        palloc_free_page(pagedir_get_page(thread_current()->pagedir, vme->vaddr));
-        pagedir_clear_page(thread_current()->pagedir, vme->vaddr);
-    }
+    frame_unmap(vme);
+    if(vme->type == VM_ANON && vme->swap_slot != SWAP_SLOT_NONE)
+        swap_free(vme->swap_slot);
     free(vme);
 }
 
@@ -69,4 +79,80 @@ bool load_file(void *kaddr, struct vm_entry *vme) {
     memset (kaddr + vme->read_bytes, 0, vme->zero_bytes);
 
     return true;
-}
\ No newline at end of file
+}
+
+/* Returns true if a fault at ADDR with user stack pointer ESP
+   looks like a stack access.  PUSHA may touch 32 bytes below
+   ESP before moving it, and the stack may not grow past
+   stack_page_limit pages below PHYS_BASE. */
+bool is_stack_access (void *addr, void *esp) {
+    uint8_t *bottom = (uint8_t *) PHYS_BASE - stack_page_limit * PGSIZE;
+
+    return is_user_vaddr(addr)
+           && (uint8_t *) addr >= bottom
+           && (uint8_t *) addr + 32 >= (uint8_t *) esp;
+}
+
+/* Adds a demand-zero stack page containing ADDR to the current
+   thread's address space.  Nothing is allocated until the page
+   is first touched.
+   Returns the new entry, or a null pointer on failure. */
+struct vm_entry *expand_stack (void *addr) {
+    struct vm_entry *vme = malloc(sizeof(struct vm_entry));
+    if (vme == NULL)
+        return NULL;
+
+    memset(vme, 0, sizeof(struct vm_entry));
+    vme->type = VM_ANON;
+    vme->vaddr = pg_round_down(addr);
+    vme->writeable = true;
+    vme->is_loaded = false;
+    vme->zero_bytes = PGSIZE;
+    vme->swap_slot = SWAP_SLOT_NONE;
+
+    if (!insert_vme(&thread_current()->vm, vme)) {
+        free(vme);
+        return NULL;
+    }
+    return vme;
+}
+
+/* Records a file-backed fault that populated PAGES extra pages. */
+void vm_count_fault_around (size_t pages) {
+    file_fault_cnt++;
+    fault_around_cnt += pages;
+}
+
+/* Prints paging statistics. */
+void vm_print_stats (void) {
+    printf ("Paging: %lld file faults, %lld pages faulted around\n",
+            file_fault_cnt, fault_around_cnt);
+}
+
+/* Returns true if every page of the SIZE bytes at ADDR is part of
+   the current thread's address space, adding stack pages for the
+   parts that are stack accesses relative to ESP.  If WRITE is
+   true, every page must also be writable.
+   Looks up each page once rather than each byte. */
+bool vm_check_range (const void *addr, size_t size, bool write, void *esp) {
+    const uint8_t *start = addr;
+    const uint8_t *upage;
+
+    if (size == 0)
+        return true;
+    if (start < (uint8_t *) USER_BASE || !is_user_vaddr(start + size - 1)
+        || start + size - 1 < start)
+        return false;
+
+    for (upage = pg_round_down(start); upage < start + size; upage += PGSIZE) {
+        /* First byte of the range on this page. */
+        void *p = (void *) (upage < start ? start : upage);
+        struct vm_entry *vme = find_vme(p);
+
+        if (vme == NULL && is_stack_access(p, esp))
+            vme = expand_stack(p);
+        if (vme == NULL || (write && !vme->writeable))
+            return false;
+    }
+    return true;
+}
@@ -18,6 +18,18 @@
 #define VM_FILE 1
 #define VM_ANON 2
 
+/* Largest fault-around window, in pages. */
+#define FAULT_AROUND_MAX 16
+
+/* Lowest user virtual address: where executables are loaded. */
+#define USER_BASE ((void *) 0x08048000)
+
+/* Default limit on user stack growth, in pages (8 MB). */
+#define STACK_LIMIT_DEFAULT 2048
+
+/* Maximum number of user stack pages, set by "-sl". */
+extern size_t stack_page_limit;
+
 struct vm_entry {
     uint8_t type;
     void *vaddr;
@@ -32,11 +44,21 @@ struct vm_entry {
     size_t read_bytes;
     size_t zero_bytes;
 
-    // size_t swap_slot;
+    size_t swap_slot;                   /* Slot in swap, VM_ANON only */
+
+    /* Read-only VM_BIN pages share one frame among processes. */
+    struct thread *owner;               /* Thread whose address space this is */
+    struct list_elem share_elem;        /* Element in struct share's list */
 
     struct hash_elem hash_elem;
 };
 
+/* Returns true if VME may be backed by a frame shared with other
+   processes running the same executable. */
+static inline bool vme_is_shareable (const struct vm_entry *vme) {
+    return vme->type == VM_BIN && !vme->writeable;
+}
+
 struct mmap_file {
     int mapid;
     struct file *mm_file;
@@ -51,8 +73,16 @@ bool delete_vme (struct hash *vm, struct vm_entry *vme);
 
 struct vm_entry *find_vme (void *vaddr);
 
-void vm_entry (struct hash *vm);
+void vm_destroy (struct hash *vm);
 
 bool load_file (void *kaddr, struct vm_entry *vme);
 
+void vm_count_fault_around (size_t pages);
+void vm_print_stats (void);
+
+bool is_stack_access (void *addr, void *esp);
+struct vm_entry *expand_stack (void *addr);
+
+bool vm_check_range (const void *addr, size_t size, bool write, void *esp);
+
 #endif
\ No newline at end of file
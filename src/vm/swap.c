@@ -0,0 +1,81 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include "devices/block.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Number of swap device sectors that hold one page. */
+#define SECTORS_PER_PAGE (PGSIZE / BLOCK_SECTOR_SIZE)
+
+static struct block *swap_device;
+
+/* One bit per page-sized slot on the swap device, true if in use. */
+static struct bitmap *swap_map;
+static struct lock swap_lock;
+
+/* Initializes the swap slot allocator.
+   Without a swap device every swap_out() fails, so only pages
+   with a file to fall back on can be evicted. */
+void swap_init (void) {
+    lock_init (&swap_lock);
+
+    swap_device = block_get_role (BLOCK_SWAP);
+    if (swap_device == NULL)
+        return;
+
+    swap_map = bitmap_create (block_size (swap_device) / SECTORS_PER_PAGE);
+    if (swap_map == NULL)
+        PANIC ("bitmap creation failed--swap device is too large");
+}
+
+/* Writes the page at KADDR to a free swap slot and returns the
+   slot, or SWAP_SLOT_NONE if swap is full or absent. */
+size_t swap_out (void *kaddr) {
+    size_t slot;
+
+    if (swap_map == NULL)
+        return SWAP_SLOT_NONE;
+
+    lock_acquire (&swap_lock);
+    slot = bitmap_scan_and_flip (swap_map, 0, 1, false);
+    lock_release (&swap_lock);
+    if (slot == BITMAP_ERROR)
+        return SWAP_SLOT_NONE;
+
+    swap_write (slot, kaddr);
+    return slot;
+}
+
+/* Writes the page at KADDR over SLOT, which is in use. */
+void swap_write (size_t slot, void *kaddr) {
+    size_t i;
+
+    ASSERT (swap_map != NULL);
+    ASSERT (bitmap_test (swap_map, slot));
+
+    for (i = 0; i < SECTORS_PER_PAGE; i++)
+        block_write (swap_device, slot * SECTORS_PER_PAGE + i,
+                     (uint8_t *) kaddr + i * BLOCK_SECTOR_SIZE);
+}
+
+/* Reads SLOT into the page at KADDR and releases SLOT. */
+void swap_in (size_t slot, void *kaddr) {
+    size_t i;
+
+    ASSERT (swap_map != NULL);
+    ASSERT (bitmap_test (swap_map, slot));
+
+    for (i = 0; i < SECTORS_PER_PAGE; i++)
+        block_read (swap_device, slot * SECTORS_PER_PAGE + i,
+                    (uint8_t *) kaddr + i * BLOCK_SECTOR_SIZE);
+    swap_free (slot);
+}
+
+/* Releases SLOT without reading it. */
+void swap_free (size_t slot) {
+    lock_acquire (&swap_lock);
+    ASSERT (bitmap_test (swap_map, slot));
+    bitmap_reset (swap_map, slot);
+    lock_release (&swap_lock);
+}
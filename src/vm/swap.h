@@ -0,0 +1,17 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Swap slot of a vm_entry that has no copy in swap. */
+#define SWAP_SLOT_NONE SIZE_MAX
+
+void swap_init (void);
+
+size_t swap_out (void *kaddr);
+void swap_write (size_t slot, void *kaddr);
+void swap_in (size_t slot, void *kaddr);
+void swap_free (size_t slot);
+
+#endif